@@ -150,15 +150,10 @@ void Pipeline::connect()
 
 void Pipeline::worldSizeChanged()
 {
-  if (this->Reader->GetFileName())
-  {
-  this->Layout->Update();
-  double* bb = this->Layout->GetOutput()->GetBounds();
-  this->Widget->SetWorldSize(
-      sqrt(
-          ((bb[1] - bb[0]) * (bb[1] - bb[0]))
-          + ((bb[3] - bb[2]) * (bb[3] - bb[2]))));
-  }
+  // The representation estimates the world size from the bounds of the
+  // landmark centres, and only again when the layout moves them, so there is
+  // no need to update the layout here.
+  this->Widget->SetWorldSize(0.0);
 }
 
 void Pipeline::disconnect()
@@ -146,7 +146,8 @@ protected:
   //! Disconnect the pipeline and blank the view.
   void disconnect();
 
-  //! Update the world size needed by the Widget to calculate pointer length.
+  //! Let the Widget estimate the world size it uses to calculate pointer
+  //! length from the landmark centres.
   void worldSizeChanged();
 
   //! Conveniently convert a vtkImageData to a QImage.
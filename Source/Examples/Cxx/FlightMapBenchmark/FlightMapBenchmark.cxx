@@ -0,0 +1,148 @@
+#include "vtkAnnotationLayers.h"
+#include "vtkFlightMapFilter.h"
+#include "vtkGraphLayout.h"
+#include "vtkMath.h"
+#include "vtkMultiThreader.h"
+#include "vtkMutableUndirectedGraph.h"
+#include "vtkPoints.h"
+#include "vtkRandomLayoutStrategy.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+#include "vtkTulipReader.h"
+#include "vtkUndirectedGraph.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+/*
+ * This example times vtkFlightMapFilter against the number of threads, on
+ * the Marvel graph shipped in Data/ and on a generated graph of one million
+ * edges. For each thread count the flight map is rebuilt a few times and
+ * the best edge weighting and total times are reported.
+ *
+ * The weighting pass only gives a thread a block of at least 50000 edges,
+ * so on the Marvel graph (about 41500 edges) it always runs on one thread;
+ * the "used" column shows how many threads the pass was really split across.
+ *
+ * Usage: FlightMapBenchmark [file.tlp] [number of generated edges]
+ */
+
+#define NUMBER_OF_RUNS 3
+
+void CreateRandomGraph(vtkUndirectedGraph* graph, vtkIdType numEdges)
+{
+  vtkIdType numVertices = numEdges / 4 + 1;
+  vtkSmartPointer<vtkMutableUndirectedGraph> builder =
+    vtkSmartPointer<vtkMutableUndirectedGraph>::New();
+  vtkSmartPointer<vtkPoints> points =
+    vtkSmartPointer<vtkPoints>::New();
+  builder->SetNumberOfVertices(numVertices);
+  points->SetNumberOfPoints(numVertices);
+
+  vtkMath::RandomSeed(8775070);
+  for (vtkIdType i = 0; i < numVertices; ++i)
+  {
+    points->SetPoint(i, vtkMath::Random(), vtkMath::Random(), 0.0);
+  }
+  builder->SetPoints(points);
+
+  // Random end points; self loops are skipped.
+  vtkIdType added = 0;
+  while (added < numEdges)
+  {
+    vtkIdType source = static_cast<vtkIdType>(vtkMath::Random(0, numVertices));
+    vtkIdType target = static_cast<vtkIdType>(vtkMath::Random(0, numVertices));
+    if (source != target && source < numVertices && target < numVertices)
+    {
+      builder->AddEdge(source, target);
+      ++added;
+    }
+  }
+
+  if (!graph->CheckedShallowCopy(builder))
+  {
+    std::cerr << "Could not create the random graph." << std::endl;
+  }
+}
+
+void TimeFlightMap(const char* name, vtkFlightMapFilter* filter,
+    int maxThreads)
+{
+  std::cout << name << std::endl;
+  std::cout << std::setw(10) << "threads" << std::setw(8) << "used"
+    << std::setw(16) << "weighting (s)" << std::setw(12) << "total (s)"
+    << std::endl;
+
+  // Powers of two, then the largest thread count if it is not one.
+  for (int threads = 1; ; threads = std::min(2 * threads, maxThreads))
+  {
+    vtkMultiThreader::SetGlobalDefaultNumberOfThreads(threads);
+
+    double bestWeighting = VTK_DOUBLE_MAX;
+    double bestTotal = VTK_DOUBLE_MAX;
+    for (int run = 0; run < NUMBER_OF_RUNS; ++run)
+    {
+      // A modified filter always rebuilds its flight map in full.
+      filter->Modified();
+      double start = vtkTimerLog::GetUniversalTime();
+      filter->Update();
+      double total = vtkTimerLog::GetUniversalTime() - start;
+      bestWeighting = std::min(bestWeighting, filter->GetWeightingTime());
+      bestTotal = std::min(bestTotal, total);
+    }
+
+    std::cout << std::setw(10) << threads
+      << std::setw(8) << filter->GetNumberOfWeightingThreads()
+      << std::setw(16) << bestWeighting
+      << std::setw(12) << bestTotal << std::endl;
+    if (threads >= maxThreads)
+    {
+      break;
+    }
+  }
+  std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  const char* fileName = argc > 1 ? argv[1] : "../../Data/marvel.tlp";
+  vtkIdType numEdges = argc > 2 ? atol(argv[2]) : 1000000;
+  int maxThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  // The Tulip files carry no layout, so place the vertices at random.
+  vtkSmartPointer<vtkTulipReader> reader =
+    vtkSmartPointer<vtkTulipReader>::New();
+  reader->SetFileName(fileName);
+  vtkSmartPointer<vtkRandomLayoutStrategy> strategy =
+    vtkSmartPointer<vtkRandomLayoutStrategy>::New();
+  vtkSmartPointer<vtkGraphLayout> layout =
+    vtkSmartPointer<vtkGraphLayout>::New();
+  layout->SetInputConnection(reader->GetOutputPort(0));
+  layout->SetLayoutStrategy(strategy);
+
+  vtkSmartPointer<vtkFlightMapFilter> fileFilter =
+    vtkSmartPointer<vtkFlightMapFilter>::New();
+  fileFilter->SetInputConnection(0, layout->GetOutputPort());
+  fileFilter->SetInputConnection(1, reader->GetOutputPort(1));
+  layout->Update();
+  TimeFlightMap(fileName, fileFilter, maxThreads);
+
+  // A generated graph large enough to be split across threads.
+  vtkSmartPointer<vtkUndirectedGraph> randomGraph =
+    vtkSmartPointer<vtkUndirectedGraph>::New();
+  CreateRandomGraph(randomGraph, numEdges);
+  vtkSmartPointer<vtkAnnotationLayers> annotationLayers =
+    vtkSmartPointer<vtkAnnotationLayers>::New();
+
+  vtkSmartPointer<vtkFlightMapFilter> randomFilter =
+    vtkSmartPointer<vtkFlightMapFilter>::New();
+  randomFilter->SetInput(0, randomGraph);
+  randomFilter->SetInput(1, annotationLayers);
+  std::cout << randomGraph->GetNumberOfEdges() << " random edges, "
+    << randomGraph->GetNumberOfVertices() << " vertices" << std::endl;
+  TimeFlightMap("Random graph", randomFilter, maxThreads);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+#include "vtkCamera.h"
+#include "vtkCellArray.h"
+#include "vtkCellCenters.h"
+#include "vtkCellData.h"
+#include "vtkImageData.h"
+#include "vtkMath.h"
+#include "vtkOffScreenRepresentation.h"
+#include "vtkPNGWriter.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkRenderer.h"
+#include "vtkRenderWindow.h"
+#include "vtkSmartPointer.h"
+#include "vtkUnsignedCharArray.h"
+#include "vtkWindowToImageFilter.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/*
+ * This example checks that vtkOffScreenRepresentation draws the same proxies
+ * with SetInstancedProxies(true), through vtkOffScreenProxyMapper2D, as with
+ * SetInstancedProxies(false), through vtkPolyDataMapper2D. A ring of coloured
+ * landmarks is placed outside an off-screen render window and the window is
+ * captured with each mapper, for plain proxies, for proxies with overlaps
+ * reduced and errors shown, and for dimmed proxies.
+ *
+ * The proxies cover a small part of the window, so rather than an error
+ * averaged over the image, the pixels that differ are counted. At most
+ * PIXEL_FRACTION of the pixels the proxies cover may differ, to allow for
+ * rasterization at glyph edges. Captures that do not match are written out
+ * as PNG files. The exit code is EXIT_FAILURE if any pair differs or nothing
+ * was drawn.
+ *
+ * The OpenGL vendor, renderer and version are printed first. Display lists
+ * are often the least tested path of a driver, so run this against software
+ * rendering too, e.g. with LIBGL_ALWAYS_SOFTWARE=1 on a VTK built against
+ * Mesa, which should report an llvmpipe renderer.
+ */
+
+// Colour difference (in any channel) for two pixels to differ.
+#define PIXEL_TOLERANCE 16
+#define PIXEL_FRACTION 0.05
+
+void CreateLandmarks(vtkPolyData* landmarks)
+{
+  // One small triangle per landmark, coloured through "Hull color" with a
+  // spread of hues and opacities. They lie in six clusters whose proxies
+  // overlap on the bezel.
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+  vtkSmartPointer<vtkUnsignedCharArray> colours =
+    vtkSmartPointer<vtkUnsignedCharArray>::New();
+  colours->SetName("Hull color");
+  colours->SetNumberOfComponents(4);
+
+  int numLandmarks = 40;
+  for (int i = 0; i < numLandmarks; ++i)
+  {
+    double angle = vtkMath::RadiansFromDegrees(
+        60.0 * (i % 6) + 2.0 * (i / 6));
+    double distance = 5.0 + 2.0 * (i % 7);
+    double x = distance * cos(angle);
+    double y = distance * sin(angle);
+
+    vtkIdType ids[3];
+    ids[0] = points->InsertNextPoint(x, y, 0.0);
+    ids[1] = points->InsertNextPoint(x + 0.1, y, 0.0);
+    ids[2] = points->InsertNextPoint(x, y + 0.1, 0.0);
+    polys->InsertNextCell(3, ids);
+
+    unsigned char colour[4];
+    colour[0] = static_cast<unsigned char>(255 * (i % 3 == 0));
+    colour[1] = static_cast<unsigned char>(255 * (i % 3 == 1));
+    colour[2] = static_cast<unsigned char>(255 * (i % 3 == 2));
+    colour[3] = static_cast<unsigned char>(255 - 20 * (i % 5));
+    colours->InsertNextTupleValue(colour);
+  }
+
+  landmarks->SetPoints(points);
+  landmarks->SetPolys(polys);
+  landmarks->GetCellData()->AddArray(colours);
+}
+
+void Capture(vtkRenderWindow* window, vtkImageData* image)
+{
+  window->Render();
+  vtkSmartPointer<vtkWindowToImageFilter> grabber =
+    vtkSmartPointer<vtkWindowToImageFilter>::New();
+  grabber->SetInput(window);
+  grabber->ReadFrontBufferOff();
+  grabber->Update();
+  image->DeepCopy(grabber->GetOutput());
+}
+
+vtkIdType CountDifferentPixels(vtkImageData* image1, vtkImageData* image2)
+{
+  vtkUnsignedCharArray* pixels1 = vtkUnsignedCharArray::SafeDownCast(
+      image1->GetPointData()->GetScalars());
+  vtkUnsignedCharArray* pixels2 = vtkUnsignedCharArray::SafeDownCast(
+      image2->GetPointData()->GetScalars());
+  vtkIdType numPixels = pixels1->GetNumberOfTuples();
+  int numComponents = pixels1->GetNumberOfComponents();
+  if (pixels2->GetNumberOfTuples() != numPixels
+      || pixels2->GetNumberOfComponents() != numComponents)
+  {
+    return numPixels;
+  }
+
+  const unsigned char* p1 = pixels1->GetPointer(0);
+  const unsigned char* p2 = pixels2->GetPointer(0);
+  vtkIdType count = 0;
+  for (vtkIdType i = 0; i < numPixels; ++i)
+  {
+    for (int c = 0; c < numComponents; ++c)
+    {
+      int delta = p1[i * numComponents + c] - p2[i * numComponents + c];
+      if (delta > PIXEL_TOLERANCE || delta < -PIXEL_TOLERANCE)
+      {
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+void WriteImage(vtkImageData* image, const std::string& fileName)
+{
+  vtkSmartPointer<vtkPNGWriter> writer = vtkSmartPointer<vtkPNGWriter>::New();
+  writer->SetInput(image);
+  writer->SetFileName(fileName.c_str());
+  writer->Write();
+}
+
+bool CompareMappers(const char* name, vtkRenderWindow* window,
+    vtkOffScreenRepresentation* representation, vtkImageData* background)
+{
+  vtkSmartPointer<vtkImageData> polyDataImage =
+    vtkSmartPointer<vtkImageData>::New();
+  vtkSmartPointer<vtkImageData> instancedImage =
+    vtkSmartPointer<vtkImageData>::New();
+  representation->SetInstancedProxies(false);
+  Capture(window, polyDataImage);
+  representation->SetInstancedProxies(true);
+  Capture(window, instancedImage);
+
+  // The pixels covered by the proxies are those that differ from the bezel
+  // alone
+  vtkIdType drawn = CountDifferentPixels(polyDataImage, background);
+  vtkIdType different = CountDifferentPixels(polyDataImage, instancedImage);
+
+  bool passed = drawn > 0 && different <= PIXEL_FRACTION * drawn;
+  std::cout << (passed ? "ok   " : "FAIL ") << name << ": " << different
+    << " of " << drawn << " proxy pixels differ" << std::endl;
+  if (!passed)
+  {
+    WriteImage(polyDataImage, std::string(name) + "-polydata.png");
+    WriteImage(instancedImage, std::string(name) + "-instanced.png");
+  }
+  return passed;
+}
+
+int main(int, char*[])
+{
+  vtkSmartPointer<vtkPolyData> landmarks = vtkSmartPointer<vtkPolyData>::New();
+  CreateLandmarks(landmarks);
+  vtkSmartPointer<vtkCellCenters> landmarkCentres =
+    vtkSmartPointer<vtkCellCenters>::New();
+  landmarkCentres->SetInput(landmarks);
+
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  renderer->SetBackground(1.0, 1.0, 1.0);
+  vtkCamera* camera = renderer->GetActiveCamera();
+  camera->ParallelProjectionOn();
+  camera->SetParallelScale(2.0);
+  camera->SetPosition(0.0, 0.0, 10.0);
+  camera->SetFocalPoint(0.0, 0.0, 0.0);
+  camera->SetViewUp(0.0, 1.0, 0.0);
+
+  vtkSmartPointer<vtkRenderWindow> window =
+    vtkSmartPointer<vtkRenderWindow>::New();
+  window->SetOffScreenRendering(1);
+  window->SetSize(400, 400);
+  window->AddRenderer(renderer);
+
+  vtkSmartPointer<vtkOffScreenRepresentation> representation =
+    vtkSmartPointer<vtkOffScreenRepresentation>::New();
+  representation->SetRenderer(renderer);
+  renderer->AddViewProp(representation);
+
+  // The bezel alone, to tell that proxies were drawn
+  vtkSmartPointer<vtkImageData> background =
+    vtkSmartPointer<vtkImageData>::New();
+  Capture(window, background);
+  representation->SetLandmarkCentres(landmarkCentres);
+
+  std::string capabilities = window->ReportCapabilities();
+  std::cout << capabilities.substr(0, capabilities.find("OpenGL extensions"));
+
+  bool passed = true;
+  passed = CompareMappers("plain", window, representation, background)
+    && passed;
+
+  representation->SetReduceOverlaps(true);
+  representation->SetShowError(true);
+  passed = CompareMappers("reduced", window, representation, background)
+    && passed;
+
+  representation->DimMultiply(0.5);
+  passed = CompareMappers("dimmed", window, representation, background)
+    && passed;
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,290 @@
+#include "vtkAnnotatedGraphRepresentation.h"
+#include "vtkAnnotatedGraphView.h"
+#include "vtkAnnotationLink.h"
+#include "vtkIdTypeArray.h"
+#include "vtkMath.h"
+#include "vtkMutableUndirectedGraph.h"
+#include "vtkPoints.h"
+#include "vtkPolygon.h"
+#include "vtkRenderWindow.h"
+#include "vtkSelection.h"
+#include "vtkSelectionNode.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*
+ * This example checks that the lasso selection of
+ * vtkAnnotatedGraphRepresentation, which bins the vertices in a grid and
+ * tests only those near the edge of the lasso exactly, selects the same
+ * vertices as testing every vertex with vtkPolygon::PointInPolygon. Random
+ * lassos (star shaped, self-intersecting, enclosing, tiny and degenerate)
+ * are drawn over several layouts, including a collinear one on which every
+ * lasso is degenerate. A degenerate lasso must select nothing.
+ *
+ * The time taken by each method is reported. The exit code is EXIT_FAILURE
+ * if any selection differs.
+ */
+
+#define NUMBER_OF_LASSOS 40
+
+// Select the vertices inside the lasso by testing every one, as the
+// representation did before it used a grid. Returns false, with nothing
+// selected, if the test fails.
+bool BruteForceSelect(vtkPoints* graphPoints, vtkPoints* lassoPoints,
+    std::vector<vtkIdType>& selected)
+{
+  selected.clear();
+  lassoPoints->ComputeBounds();
+  double* bounds = lassoPoints->GetBounds();
+  double* lasso =
+    static_cast<double*>(lassoPoints->GetData()->GetVoidPointer(0));
+  int numLassoPoints = lassoPoints->GetNumberOfPoints();
+  double n[3];
+  vtkPolygon::ComputeNormal(graphPoints, n);
+  double x[3];
+  for (vtkIdType i = 0; i < graphPoints->GetNumberOfPoints(); ++i)
+  {
+    graphPoints->GetPoint(i, x);
+    x[2] = 0.0;
+    int result = vtkPolygon::PointInPolygon(x, numLassoPoints, lasso, bounds,
+        n);
+    if (result == -1)
+    {
+      selected.clear();
+      return false;
+    }
+    else if (result == 1)
+    {
+      selected.push_back(i);
+    }
+  }
+  return true;
+}
+
+// Select the vertices inside the lasso through the representation.
+void GridSelect(vtkAnnotatedGraphRepresentation* representation,
+    vtkPoints* lassoPoints, std::vector<vtkIdType>& selected)
+{
+  selected.clear();
+  vtkSmartPointer<vtkSelection> empty = vtkSmartPointer<vtkSelection>::New();
+  representation->GetAnnotationLink()->SetCurrentSelection(empty);
+  representation->LassoSelect(lassoPoints, false);
+
+  vtkSelection* selection =
+    representation->GetAnnotationLink()->GetCurrentSelection();
+  if (!selection || selection->GetNumberOfNodes() == 0)
+  {
+    return;
+  }
+  vtkIdTypeArray* ids = vtkIdTypeArray::SafeDownCast(
+      selection->GetNode(0)->GetSelectionList());
+  for (vtkIdType i = 0; ids && i < ids->GetNumberOfTuples(); ++i)
+  {
+    selected.push_back(ids->GetValue(i));
+  }
+}
+
+// Whether the lasso has no area, when nothing may be selected.
+bool IsDegenerate(vtkPoints* lassoPoints, vtkPoints* graphPoints)
+{
+  double n[3];
+  vtkPolygon::ComputeNormal(lassoPoints, n);
+  double layoutNormal[3];
+  vtkPolygon::ComputeNormal(graphPoints, layoutNormal);
+  return lassoPoints->GetNumberOfPoints() < 3 || vtkMath::Norm(n) == 0.0
+    || vtkMath::Norm(layoutNormal) == 0.0;
+}
+
+// A random lasso over bounds. The lasso points are doubles, as the
+// representation reads them.
+void CreateLasso(int trial, const double bounds[6], vtkPoints* lasso)
+{
+  lasso->Reset();
+  lasso->SetDataTypeToDouble();
+  double width = bounds[1] - bounds[0] + 1.0;
+  double height = bounds[3] - bounds[2] + 1.0;
+  double centre[2] = {
+    vtkMath::Random(bounds[0] - 0.2 * width, bounds[1] + 0.2 * width),
+    vtkMath::Random(bounds[2] - 0.2 * height, bounds[3] + 0.2 * height) };
+
+  switch (trial % 6)
+  {
+    case 0:
+    case 1:
+    {
+      // Star shaped, concave where the radius varies
+      int numPoints = static_cast<int>(vtkMath::Random(3.0, 80.0));
+      double radius = vtkMath::Random(0.05, 0.6) * std::max(width, height);
+      double spread = trial % 2 ? 0.8 : 0.1;
+      for (int i = 0; i < numPoints; ++i)
+      {
+        double angle = 2.0 * vtkMath::Pi() * i / numPoints;
+        double r = radius * vtkMath::Random(1.0 - spread, 1.0);
+        lasso->InsertNextPoint(centre[0] + r * cos(angle),
+            centre[1] + r * sin(angle), 0.0);
+      }
+      break;
+    }
+    case 2:
+    {
+      // A scribble that crosses itself
+      int numPoints = static_cast<int>(vtkMath::Random(4.0, 30.0));
+      for (int i = 0; i < numPoints; ++i)
+      {
+        lasso->InsertNextPoint(
+            centre[0] + vtkMath::Random(-0.3, 0.3) * width,
+            centre[1] + vtkMath::Random(-0.3, 0.3) * height, 0.0);
+      }
+      break;
+    }
+    case 3:
+    {
+      // Around the whole layout
+      lasso->InsertNextPoint(bounds[0] - 1.0, bounds[2] - 1.0, 0.0);
+      lasso->InsertNextPoint(bounds[1] + 1.0, bounds[2] - 1.0, 0.0);
+      lasso->InsertNextPoint(bounds[1] + 1.0, bounds[3] + 1.0, 0.0);
+      lasso->InsertNextPoint(bounds[0] - 1.0, bounds[3] + 1.0, 0.0);
+      break;
+    }
+    case 4:
+    {
+      // Smaller than a grid cell
+      double size = 0.001 * width;
+      lasso->InsertNextPoint(centre[0], centre[1], 0.0);
+      lasso->InsertNextPoint(centre[0] + size, centre[1], 0.0);
+      lasso->InsertNextPoint(centre[0], centre[1] + size, 0.0);
+      break;
+    }
+    default:
+    {
+      // Degenerate: a line drawn back and forth, or a single stroke
+      int numPoints = trial % 4 ? 6 : 2;
+      for (int i = 0; i < numPoints; ++i)
+      {
+        double t = i < numPoints / 2 ? i : numPoints - i;
+        lasso->InsertNextPoint(centre[0] + 0.1 * t * width,
+            centre[1] + 0.05 * t * height, 0.0);
+      }
+      break;
+    }
+  }
+}
+
+bool CheckLayout(const char* name, vtkPoints* points)
+{
+  vtkSmartPointer<vtkMutableUndirectedGraph> graph =
+    vtkSmartPointer<vtkMutableUndirectedGraph>::New();
+  for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i)
+  {
+    graph->AddVertex();
+  }
+  graph->SetPoints(points);
+
+  vtkSmartPointer<vtkAnnotatedGraphView> view =
+    vtkSmartPointer<vtkAnnotatedGraphView>::New();
+  view->GetRenderWindow()->SetOffScreenRendering(1);
+  view->SetLayoutStrategyToPassThrough();
+  view->SetRepresentationFromInput(graph);
+  view->Render();
+  vtkAnnotatedGraphRepresentation* representation =
+    vtkAnnotatedGraphRepresentation::SafeDownCast(view->GetRepresentation());
+
+  double bounds[6];
+  points->GetBounds(bounds);
+  vtkSmartPointer<vtkPoints> lasso = vtkSmartPointer<vtkPoints>::New();
+  vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
+  std::vector<vtkIdType> expected;
+  std::vector<vtkIdType> selected;
+  double bruteForceTime = 0.0;
+  double gridTime = 0.0;
+  int numSelected = 0;
+  int numDifferent = 0;
+  for (int trial = 0; trial < NUMBER_OF_LASSOS; ++trial)
+  {
+    CreateLasso(trial, bounds, lasso);
+
+    timer->StartTimer();
+    BruteForceSelect(points, lasso, expected);
+    timer->StopTimer();
+    bruteForceTime += timer->GetElapsedTime();
+    if (IsDegenerate(lasso, points))
+    {
+      expected.clear();
+    }
+
+    timer->StartTimer();
+    GridSelect(representation, lasso, selected);
+    timer->StopTimer();
+    gridTime += timer->GetElapsedTime();
+
+    numSelected += static_cast<int>(selected.size());
+    if (selected != expected)
+    {
+      ++numDifferent;
+      std::cout << "  lasso " << trial << " (" << lasso->GetNumberOfPoints()
+        << " points): " << selected.size() << " selected, "
+        << expected.size() << " expected" << std::endl;
+    }
+  }
+
+  bool passed = numDifferent == 0;
+  std::cout << (passed ? "ok   " : "FAIL ") << name << ": "
+    << points->GetNumberOfPoints() << " vertices, " << NUMBER_OF_LASSOS
+    << " lassos, " << numSelected << " selected, " << numDifferent
+    << " different; brute force " << bruteForceTime << " s, grid "
+    << gridTime << " s" << std::endl;
+  return passed;
+}
+
+int main(int, char*[])
+{
+  // Degenerate lassos are expected, so their warnings are noise
+  vtkObject::GlobalWarningDisplayOff();
+  vtkMath::RandomSeed(2510);
+  bool passed = true;
+  int numVertices = 20000;
+  vtkSmartPointer<vtkPoints> points;
+
+  points = vtkSmartPointer<vtkPoints>::New();
+  for (int i = 0; i < numVertices; ++i)
+  {
+    points->InsertNextPoint(vtkMath::Random(0.0, 100.0),
+        vtkMath::Random(0.0, 50.0), 0.0);
+  }
+  passed = CheckLayout("uniform", points) && passed;
+
+  // Dense clusters leave most grid cells empty and a few crowded
+  points = vtkSmartPointer<vtkPoints>::New();
+  for (int i = 0; i < numVertices; ++i)
+  {
+    double cluster = i % 7;
+    points->InsertNextPoint(
+        20.0 * cluster + vtkMath::Gaussian(0.0, 1.0 + cluster),
+        10.0 * (i % 3) + vtkMath::Gaussian(0.0, 2.0), 0.0);
+  }
+  passed = CheckLayout("clusters", points) && passed;
+
+  // Vertices on the lines between grid cells
+  points = vtkSmartPointer<vtkPoints>::New();
+  for (int i = 0; i < numVertices; ++i)
+  {
+    points->InsertNextPoint(i % 141, i / 141, 0.0);
+  }
+  passed = CheckLayout("lattice", points) && passed;
+
+  // No plane to test in, so every lasso is degenerate
+  points = vtkSmartPointer<vtkPoints>::New();
+  for (int i = 0; i < 1000; ++i)
+  {
+    points->InsertNextPoint(i, 0.5 * i, 0.0);
+  }
+  passed = CheckLayout("collinear", points) && passed;
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,322 @@
+#include "vtkCamera.h"
+#include "vtkDoubleArray.h"
+#include "vtkIntArray.h"
+#include "vtkMath.h"
+#include "vtkOffScreenRepresentationImpl.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkRenderer.h"
+#include "vtkRenderWindow.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*
+ * This example checks the overlap reduction of
+ * vtkOffScreenRepresentationImpl. Sets of off-screen points at known angles
+ * are placed around an off-screen render window and the proxies on output
+ * port 2 are checked:
+ *
+ *  - the proxies keep the order of their points around the bezel,
+ *  - no two proxies overlap,
+ *  - each proxy is moved by its "proxy error", and by at most half a turn.
+ *
+ * The sets include clusters on either side of 0 degrees and across it, so
+ * that the last segment of the sweep absorbs the first (and then the
+ * segments before it), and coincident points that spread over a wide arc.
+ * Random sets follow. The exit code is EXIT_FAILURE if any check fails.
+ *
+ * Finally 10000 proxies at random angles are reduced, far more than fit
+ * around the bezel, and the time an update takes with and without overlap
+ * reduction is reported, along with the time for 1000 proxies to show how
+ * the reduction scales.
+ */
+
+// Proxies are 3 degrees wide, see vtkOffScreenRepresentationImpl.
+#define PROXY_WIDTH 3.0
+#define TOLERANCE 1e-3
+
+// Wrap an angle in degrees into [-180, 180).
+double WrapAngle(double degrees)
+{
+  return degrees - 360.0 * floor((degrees + 180.0) / 360.0);
+}
+
+struct PlacedProxy
+{
+  double Original;
+  double Final;
+  double Error;
+
+  bool operator<(const PlacedProxy& other) const
+  {
+    if (this->Original != other.Original)
+    {
+      return this->Original < other.Original;
+    }
+    // Proxies of coincident points may be in any order: follow their
+    // placement.
+    return WrapAngle(this->Final - this->Original)
+      < WrapAngle(other.Final - other.Original);
+  }
+};
+
+// Points far outside a view of [-1, 1] x [-1, 1] at the given angles
+void CreateInput(const std::vector<double>& angles, vtkPolyData* input)
+{
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetNumberOfPoints(static_cast<vtkIdType>(angles.size()));
+  for (size_t i = 0; i < angles.size(); ++i)
+  {
+    double angle = vtkMath::RadiansFromDegrees(angles[i]);
+    points->SetPoint(static_cast<vtkIdType>(i), 1000.0 * cos(angle),
+        1000.0 * sin(angle), 0.0);
+  }
+  input->SetPoints(points);
+}
+
+// A 400 x 400 off-screen window showing [-1, 1] x [-1, 1]
+void CreateView(vtkRenderWindow* window, vtkRenderer* renderer)
+{
+  window->SetOffScreenRendering(1);
+  window->SetSize(400, 400);
+  window->AddRenderer(renderer);
+  vtkCamera* camera = renderer->GetActiveCamera();
+  camera->ParallelProjectionOn();
+  camera->SetParallelScale(1.0);
+  camera->SetPosition(0.0, 0.0, 10.0);
+  camera->SetFocalPoint(0.0, 0.0, 0.0);
+  camera->SetViewUp(0.0, 1.0, 0.0);
+}
+
+bool CheckOverlapReduction(const char* name,
+    const std::vector<double>& angles)
+{
+  vtkSmartPointer<vtkPolyData> input = vtkSmartPointer<vtkPolyData>::New();
+  CreateInput(angles, input);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  vtkSmartPointer<vtkRenderWindow> window =
+    vtkSmartPointer<vtkRenderWindow>::New();
+  CreateView(window, renderer);
+
+  vtkSmartPointer<vtkOffScreenRepresentationImpl> representation =
+    vtkSmartPointer<vtkOffScreenRepresentationImpl>::New();
+  representation->SetRenderer(renderer);
+  representation->SetInput(input);
+  representation->ReduceOverlapsOn();
+  representation->Update();
+
+  // Recover the placement of each proxy from its anchor on the bezel
+  vtkPolyData* instances = representation->GetOutput(2);
+  vtkIntArray* ids = vtkIntArray::SafeDownCast(
+      instances->GetPointData()->GetArray("poly id"));
+  vtkDoubleArray* errors = vtkDoubleArray::SafeDownCast(
+      instances->GetPointData()->GetArray("proxy error"));
+  vtkIdType numProxies = instances->GetNumberOfPoints();
+  std::vector<PlacedProxy> proxies(numProxies);
+  double centre[2] = { 200.0, 200.0 };
+  for (vtkIdType i = 0; i < numProxies; ++i)
+  {
+    double* anchor = instances->GetPoint(i);
+    PlacedProxy& proxy = proxies[i];
+    proxy.Original = angles[ids->GetValue(i)];
+    proxy.Original -= 360.0 * floor(proxy.Original / 360.0);
+    proxy.Final = vtkMath::DegreesFromRadians(
+        atan2(anchor[1] - centre[1], anchor[0] - centre[0]));
+    proxy.Error = errors->GetValue(i);
+  }
+  std::sort(proxies.begin(), proxies.end());
+
+  bool passed = numProxies == static_cast<vtkIdType>(angles.size());
+  double turn = 0.0;
+  double smallestGap = 360.0;
+  double largestError = 0.0;
+  for (vtkIdType i = 0; i < numProxies; ++i)
+  {
+    const PlacedProxy& proxy = proxies[i];
+    const PlacedProxy& next = proxies[(i + 1) % numProxies];
+
+    // Moved by the reported error, and by at most half a turn
+    if (fabs(proxy.Error) > 180.0 + TOLERANCE
+        || fabs(WrapAngle(proxy.Original - proxy.Error - proxy.Final))
+          > TOLERANCE)
+    {
+      passed = false;
+    }
+    largestError = std::max(largestError, fabs(proxy.Error));
+
+    // Walking the proxies in the order of their points must go round the
+    // bezel exactly once, never stepping back or onto the previous proxy.
+    if (numProxies > 1)
+    {
+      double gap = next.Final - proxy.Final;
+      gap -= 360.0 * floor(gap / 360.0);
+      turn += gap;
+      smallestGap = std::min(smallestGap, gap);
+    }
+  }
+  if (numProxies > 1
+      && (fabs(turn - 360.0) > TOLERANCE
+        || smallestGap < PROXY_WIDTH - TOLERANCE))
+  {
+    passed = false;
+  }
+
+  std::cout << (passed ? "ok   " : "FAIL ") << name << ": "
+    << numProxies << " proxies, smallest gap " << smallestGap
+    << ", largest error " << largestError << std::endl;
+  return passed;
+}
+
+// The mean time of an update of numProxies proxies at random angles, with or
+// without overlap reduction. Returns a negative time if a proxy is lost.
+double TimeUpdate(int numProxies, bool reduceOverlaps)
+{
+  std::vector<double> angles(numProxies);
+  for (int i = 0; i < numProxies; ++i)
+  {
+    angles[i] = vtkMath::Random(0.0, 360.0);
+  }
+  vtkSmartPointer<vtkPolyData> input = vtkSmartPointer<vtkPolyData>::New();
+  CreateInput(angles, input);
+  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+  vtkSmartPointer<vtkRenderWindow> window =
+    vtkSmartPointer<vtkRenderWindow>::New();
+  CreateView(window, renderer);
+
+  vtkSmartPointer<vtkOffScreenRepresentationImpl> representation =
+    vtkSmartPointer<vtkOffScreenRepresentationImpl>::New();
+  representation->SetRenderer(renderer);
+  representation->SetInput(input);
+  representation->SetReduceOverlaps(reduceOverlaps);
+  representation->Update();
+
+  int numUpdates = 10;
+  vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
+  timer->StartTimer();
+  for (int i = 0; i < numUpdates; ++i)
+  {
+    representation->Modified();
+    representation->Update();
+  }
+  timer->StopTimer();
+
+  if (representation->GetOutput(2)->GetNumberOfPoints() != numProxies)
+  {
+    return -1.0;
+  }
+  return timer->GetElapsedTime() / numUpdates;
+}
+
+// Report the cost of reducing numProxies proxies: the extra time an update
+// takes with overlap reduction on.
+bool TimeOverlapReduction(int numProxies)
+{
+  double plain = TimeUpdate(numProxies, false);
+  double reduced = TimeUpdate(numProxies, true);
+  bool passed = plain >= 0.0 && reduced >= 0.0;
+  std::cout << (passed ? "ok   " : "FAIL ") << "timing: " << numProxies
+    << " proxies, update " << plain << " s, with overlap reduction "
+    << reduced << " s (reduction " << reduced - plain << " s)" << std::endl;
+  return passed;
+}
+
+int main(int, char*[])
+{
+  bool passed = true;
+  std::vector<double> angles;
+
+  angles.clear();
+  for (int i = 0; i < 10; ++i)
+  {
+    angles.push_back(36.0 * i);
+  }
+  passed = CheckOverlapReduction("apart", angles) && passed;
+
+  angles.clear();
+  for (int i = 0; i < 20; ++i)
+  {
+    angles.push_back(90.0 + 0.1 * i);
+  }
+  passed = CheckOverlapReduction("cluster", angles) && passed;
+
+  angles.clear();
+  for (int i = 0; i < 15; ++i)
+  {
+    angles.push_back(358.0 + 0.1 * i);
+  }
+  passed = CheckOverlapReduction("below zero", angles) && passed;
+
+  angles.clear();
+  for (int i = 0; i < 15; ++i)
+  {
+    angles.push_back(0.1 * i);
+  }
+  passed = CheckOverlapReduction("above zero", angles) && passed;
+
+  // The last segment absorbs the first one turn further round
+  angles.clear();
+  for (int i = 0; i < 20; ++i)
+  {
+    angles.push_back(350.0 + i);
+  }
+  passed = CheckOverlapReduction("across zero", angles) && passed;
+
+  // Absorbing the first segments grows the last back over its predecessors
+  angles.clear();
+  for (int i = 0; i < 25; ++i)
+  {
+    angles.push_back(10.0);
+    angles.push_back(350.0);
+  }
+  for (int i = 0; i < 10; ++i)
+  {
+    angles.push_back(300.0 + 2.0 * i);
+    angles.push_back(60.0 + 2.0 * i);
+  }
+  passed = CheckOverlapReduction("cascade", angles) && passed;
+
+  angles.clear();
+  for (int i = 0; i < 60; ++i)
+  {
+    angles.push_back(0.0);
+  }
+  passed = CheckOverlapReduction("coincident", angles) && passed;
+
+  angles.clear();
+  for (int i = 0; i < 100; ++i)
+  {
+    angles.push_back(3.6 * i + 1.0);
+  }
+  passed = CheckOverlapReduction("full circle", angles) && passed;
+
+  // Random clusters; no more proxies than fit around the bezel. The angles
+  // are rounded to a hundredth of a degree so that the offset of the display
+  // centre (half a pixel) cannot swap two points.
+  vtkMath::RandomSeed(1704);
+  for (int trial = 0; trial < 50; ++trial)
+  {
+    angles.clear();
+    int numProxies = static_cast<int>(vtkMath::Random(2.0, 100.0));
+    int numClusters = static_cast<int>(vtkMath::Random(1.0, 6.0));
+    for (int i = 0; i < numProxies; ++i)
+    {
+      double centre = 360.0 * (i % numClusters) / numClusters
+        + 7.0 * trial;
+      angles.push_back(
+          floor(100.0 * (centre + vtkMath::Random(-10.0, 10.0))) / 100.0);
+    }
+    passed = CheckOverlapReduction("random", angles) && passed;
+  }
+
+  passed = TimeOverlapReduction(1000) && passed;
+  passed = TimeOverlapReduction(10000) && passed;
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,432 @@
+#include "vtkAnnotation.h"
+#include "vtkAnnotationLayers.h"
+#include "vtkDataSetAttributes.h"
+#include "vtkDoubleArray.h"
+#include "vtkEdgeListIterator.h"
+#include "vtkFlightMapFilter.h"
+#include "vtkGraphLayout.h"
+#include "vtkIdTypeArray.h"
+#include "vtkInformation.h"
+#include "vtkMath.h"
+#include "vtkRandomLayoutStrategy.h"
+#include "vtkSelection.h"
+#include "vtkSelectionNode.h"
+#include "vtkSmartPointer.h"
+#include "vtkTulipReader.h"
+#include "vtkUndirectedGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/*
+ * This example checks that the two spanning tree backends of
+ * vtkFlightMapFilter agree. Each graph is laid out at random and its flight
+ * map is built with vtkBoostKruskalMinimumSpanningTree and with the native
+ * filter-Kruskal, for both presets and for minimum and maximum trees.
+ *
+ * Spanning trees of the same graph may differ where weights tie, but every
+ * minimum (or maximum) spanning forest has the same number of edges and the
+ * same multiset of edge weights. Those must match exactly; differences in
+ * the edge sets are only reported. The "parent" and "parent edge" arrays of
+ * every output must describe the output tree, rooted at the lowest numbered
+ * vertex of each component.
+ *
+ * The incremental updates are then checked: random annotations are added,
+ * disabled and removed, and after each edit the flight map repaired by one
+ * filter must be identical, edge ids and parent arrays included, to the one
+ * rebuilt from scratch by another. With the Boost backend no update may be
+ * incremental.
+ *
+ * Usage: SpanningTreeCheck [file.tlp ...]
+ * Without arguments the graphs in ../../Data are checked. The exit code is
+ * EXIT_FAILURE if any check fails.
+ */
+
+typedef std::pair<vtkIdType, vtkIdType> Edge;
+
+struct SpanningTree
+{
+  std::vector<Edge> Edges;
+  std::vector<double> Weights;
+  double TotalWeight;
+};
+
+void GetSpanningTree(vtkGraph* tree, SpanningTree& result)
+{
+  vtkDoubleArray* weights = vtkDoubleArray::SafeDownCast(
+      tree->GetEdgeData()->GetArray("weights"));
+  result.Edges.clear();
+  result.Weights.clear();
+  result.TotalWeight = 0.0;
+
+  vtkSmartPointer<vtkEdgeListIterator> edges =
+    vtkSmartPointer<vtkEdgeListIterator>::New();
+  tree->GetEdges(edges);
+  while (edges->HasNext())
+  {
+    vtkEdgeType edge = edges->Next();
+    result.Edges.push_back(Edge(std::min(edge.Source, edge.Target),
+        std::max(edge.Source, edge.Target)));
+    double weight = weights->GetValue(edge.Id);
+    result.Weights.push_back(weight);
+    result.TotalWeight += weight;
+  }
+  std::sort(result.Edges.begin(), result.Edges.end());
+  std::sort(result.Weights.begin(), result.Weights.end());
+}
+
+// Returns false, after reporting why, if the "parent" and "parent edge"
+// arrays do not describe the tree.
+bool CheckParents(vtkGraph* tree)
+{
+  vtkIdTypeArray* parent = vtkIdTypeArray::SafeDownCast(
+      tree->GetVertexData()->GetAbstractArray("parent"));
+  vtkIdTypeArray* parentEdge = vtkIdTypeArray::SafeDownCast(
+      tree->GetVertexData()->GetAbstractArray("parent edge"));
+  vtkIdType numVertices = tree->GetNumberOfVertices();
+  vtkIdType numEdges = tree->GetNumberOfEdges();
+  if (!parent || !parentEdge || parent->GetNumberOfTuples() != numVertices
+      || parentEdge->GetNumberOfTuples() != numVertices)
+  {
+    std::cout << "  FAIL missing parent arrays" << std::endl;
+    return false;
+  }
+
+  // Each edge joins a vertex to its parent, and is the parent edge of just
+  // that vertex.
+  std::vector<int> uses(numEdges, 0);
+  vtkIdType numRoots = 0;
+  for (vtkIdType v = 0; v < numVertices; ++v)
+  {
+    vtkIdType p = parent->GetValue(v);
+    vtkIdType e = parentEdge->GetValue(v);
+    if (p < 0)
+    {
+      ++numRoots;
+      if (e != -1)
+      {
+        std::cout << "  FAIL root " << v << " has a parent edge" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (p >= numVertices || e < 0 || e >= numEdges || uses[e]++
+        || std::min(tree->GetSourceVertex(e), tree->GetTargetVertex(e))
+          != std::min(v, p)
+        || std::max(tree->GetSourceVertex(e), tree->GetTargetVertex(e))
+          != std::max(v, p))
+    {
+      std::cout << "  FAIL vertex " << v << " has a bad parent or parent edge"
+        << std::endl;
+      return false;
+    }
+  }
+  if (numRoots != numVertices - numEdges)
+  {
+    std::cout << "  FAIL " << numRoots << " roots for " << numVertices
+      << " vertices and " << numEdges << " edges" << std::endl;
+    return false;
+  }
+
+  // Climbing from any vertex ends at the lowest numbered vertex of its
+  // component. Each climb stops at a vertex already resolved, so the whole
+  // forest is walked once.
+  std::vector<vtkIdType> root(numVertices, -2);
+  std::vector<vtkIdType> climb;
+  for (vtkIdType v = 0; v < numVertices; ++v)
+  {
+    climb.clear();
+    vtkIdType u = v;
+    while (u >= 0 && root[u] == -2)
+    {
+      root[u] = -1; // on this climb
+      climb.push_back(u);
+      u = parent->GetValue(u);
+    }
+    if (u >= 0 && root[u] == -1)
+    {
+      std::cout << "  FAIL parent cycle through vertex " << u << std::endl;
+      return false;
+    }
+    vtkIdType r = u >= 0 ? root[u] : climb.back();
+    for (size_t i = 0; i < climb.size(); ++i)
+    {
+      root[climb[i]] = r;
+    }
+    if (r > v)
+    {
+      std::cout << "  FAIL vertex " << v << " is below root " << r
+        << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns false if the trees have different weights or bad parent arrays.
+bool CompareSpanningTrees(vtkFlightMapFilter* filter)
+{
+  SpanningTree boost;
+  SpanningTree native;
+  filter->SetSpanningTreeBackendToBoostKruskal();
+  filter->Update();
+  GetSpanningTree(filter->GetOutput(), boost);
+  bool parents = CheckParents(filter->GetOutput());
+  filter->SetSpanningTreeBackendToFilterKruskal();
+  filter->Update();
+  GetSpanningTree(filter->GetOutput(), native);
+  parents = CheckParents(filter->GetOutput()) && parents;
+
+  bool same = boost.Weights == native.Weights
+    && std::fabs(boost.TotalWeight - native.TotalWeight)
+      <= 1e-9 * std::max(1.0, std::fabs(boost.TotalWeight));
+
+  std::vector<Edge> onlyBoost;
+  std::set_difference(boost.Edges.begin(), boost.Edges.end(),
+      native.Edges.begin(), native.Edges.end(),
+      std::back_inserter(onlyBoost));
+
+  std::cout << "  " << (same ? "ok  " : "FAIL")
+    << " edges " << boost.Edges.size() << "/" << native.Edges.size()
+    << ", total weight " << boost.TotalWeight << "/" << native.TotalWeight;
+  if (!onlyBoost.empty())
+  {
+    std::cout << ", " << onlyBoost.size() << " edges differ"
+      << (same ? " (tied weights)" : "");
+  }
+  std::cout << std::endl;
+  return same && parents;
+}
+
+// Returns false, after reporting the first difference, unless the two flight
+// maps are identical.
+bool SameFlightMap(vtkGraph* a, vtkGraph* b)
+{
+  vtkIdType numEdges = a->GetNumberOfEdges();
+  if (a->GetNumberOfVertices() != b->GetNumberOfVertices()
+      || numEdges != b->GetNumberOfEdges())
+  {
+    std::cout << "  FAIL " << numEdges << " edges, " << b->GetNumberOfEdges()
+      << " rebuilt" << std::endl;
+    return false;
+  }
+
+  vtkDoubleArray* weightsA = vtkDoubleArray::SafeDownCast(
+      a->GetEdgeData()->GetArray("weights"));
+  vtkDoubleArray* weightsB = vtkDoubleArray::SafeDownCast(
+      b->GetEdgeData()->GetArray("weights"));
+  for (vtkIdType e = 0; e < numEdges; ++e)
+  {
+    if (a->GetSourceVertex(e) != b->GetSourceVertex(e)
+        || a->GetTargetVertex(e) != b->GetTargetVertex(e)
+        || weightsA->GetValue(e) != weightsB->GetValue(e))
+    {
+      std::cout << "  FAIL edge " << e << " differs from the rebuilt one"
+        << std::endl;
+      return false;
+    }
+  }
+
+  const char* names[] = { "parent", "parent edge" };
+  for (int i = 0; i < 2; ++i)
+  {
+    vtkIdTypeArray* arrayA = vtkIdTypeArray::SafeDownCast(
+        a->GetVertexData()->GetAbstractArray(names[i]));
+    vtkIdTypeArray* arrayB = vtkIdTypeArray::SafeDownCast(
+        b->GetVertexData()->GetAbstractArray(names[i]));
+    for (vtkIdType v = 0; v < a->GetNumberOfVertices(); ++v)
+    {
+      if (arrayA->GetValue(v) != arrayB->GetValue(v))
+      {
+        std::cout << "  FAIL " << names[i] << " of vertex " << v
+          << " differs from the rebuilt one" << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Add an annotation selecting a few random vertices.
+void AddAnnotation(vtkAnnotationLayers* annotations, vtkIdType numVertices)
+{
+  vtkSmartPointer<vtkIdTypeArray> ids = vtkSmartPointer<vtkIdTypeArray>::New();
+  int numIds = static_cast<int>(vtkMath::Random(1.0, 20.0));
+  for (int i = 0; i < numIds; ++i)
+  {
+    ids->InsertNextValue(static_cast<vtkIdType>(
+        vtkMath::Random(0.0, static_cast<double>(numVertices))));
+  }
+  vtkSmartPointer<vtkSelectionNode> node =
+    vtkSmartPointer<vtkSelectionNode>::New();
+  node->SetContentType(vtkSelectionNode::INDICES);
+  node->SetFieldType(vtkSelectionNode::VERTEX);
+  node->SetSelectionList(ids);
+  vtkSmartPointer<vtkSelection> selection =
+    vtkSmartPointer<vtkSelection>::New();
+  selection->AddNode(node);
+  vtkSmartPointer<vtkAnnotation> annotation =
+    vtkSmartPointer<vtkAnnotation>::New();
+  annotation->SetSelection(selection);
+  annotation->GetInformation()->Set(vtkAnnotation::ENABLE(), 1);
+  annotations->AddAnnotation(annotation);
+}
+
+// Returns false if any repaired flight map differs from the rebuilt one, or
+// if the Boost backend updated incrementally.
+bool CheckIncrementalUpdates(vtkGraphLayout* layout, bool minimum)
+{
+  vtkSmartPointer<vtkAnnotationLayers> annotations =
+    vtkSmartPointer<vtkAnnotationLayers>::New();
+  vtkSmartPointer<vtkFlightMapFilter> repaired =
+    vtkSmartPointer<vtkFlightMapFilter>::New();
+  vtkSmartPointer<vtkFlightMapFilter> rebuilt =
+    vtkSmartPointer<vtkFlightMapFilter>::New();
+  vtkFlightMapFilter* filters[] = { repaired, rebuilt };
+  for (int i = 0; i < 2; ++i)
+  {
+    filters[i]->SetInputConnection(0, layout->GetOutputPort());
+    filters[i]->SetInput(1, annotations);
+    filters[i]->SetTouristPreset();
+    filters[i]->SetMinimumSpanningTree(minimum);
+    filters[i]->SetSpanningTreeBackendToFilterKruskal();
+  }
+  rebuilt->IncrementalUpdatesOff();
+  repaired->Update();
+  vtkIdType numVertices = repaired->GetOutput()->GetNumberOfVertices();
+
+  bool same = true;
+  int numIncremental = 0;
+  int numEdits = 30;
+  for (int edit = 0; edit < numEdits && same; ++edit)
+  {
+    unsigned int numAnnotations = annotations->GetNumberOfAnnotations();
+    if (numAnnotations < 3 || edit % 4 == 0)
+    {
+      AddAnnotation(annotations, numVertices);
+    }
+    else if (edit % 4 == 1)
+    {
+      // Toggle one, as the annotation panel does.
+      vtkInformation* info =
+        annotations->GetAnnotation(edit % numAnnotations)->GetInformation();
+      info->Set(vtkAnnotation::ENABLE(), !info->Get(vtkAnnotation::ENABLE()));
+    }
+    else
+    {
+      annotations->RemoveAnnotation(
+          annotations->GetAnnotation(edit % numAnnotations));
+    }
+    annotations->Modified();
+
+    repaired->Update();
+    rebuilt->Update();
+    numIncremental += repaired->GetLastUpdateWasIncremental() ? 1 : 0;
+    same = SameFlightMap(repaired->GetOutput(), rebuilt->GetOutput())
+      && CheckParents(repaired->GetOutput());
+  }
+
+  // Boost breaks ties its own way, so it must always rebuild.
+  repaired->SetSpanningTreeBackendToBoostKruskal();
+  repaired->Update();
+  AddAnnotation(annotations, numVertices);
+  annotations->Modified();
+  repaired->Update();
+  bool boostRebuilt = !repaired->GetLastUpdateWasIncremental();
+
+  bool passed = same && boostRebuilt && numIncremental > 0;
+  std::cout << "  " << (passed ? "ok  " : "FAIL")
+    << " incremental: " << numIncremental << " of " << numEdits
+    << " edits repaired" << (same ? ", same as rebuilt" : "")
+    << (boostRebuilt ? "" : ", boost updated incrementally") << std::endl;
+  return passed;
+}
+
+bool CheckGraph(const char* fileName)
+{
+  std::cout << fileName << std::endl;
+
+  // The Tulip files carry no layout; the random layout is seeded, so every
+  // run weights the same graph.
+  vtkSmartPointer<vtkTulipReader> reader =
+    vtkSmartPointer<vtkTulipReader>::New();
+  reader->SetFileName(fileName);
+  vtkSmartPointer<vtkRandomLayoutStrategy> strategy =
+    vtkSmartPointer<vtkRandomLayoutStrategy>::New();
+  vtkSmartPointer<vtkGraphLayout> layout =
+    vtkSmartPointer<vtkGraphLayout>::New();
+  layout->SetInputConnection(reader->GetOutputPort(0));
+  layout->SetLayoutStrategy(strategy);
+
+  vtkSmartPointer<vtkFlightMapFilter> filter =
+    vtkSmartPointer<vtkFlightMapFilter>::New();
+  filter->SetInputConnection(0, layout->GetOutputPort());
+  filter->SetInputConnection(1, reader->GetOutputPort(1));
+
+  bool same = true;
+  for (int preset = 0; preset < 2; ++preset)
+  {
+    if (preset == 0)
+    {
+      filter->SetExpressPreset();
+    }
+    else
+    {
+      filter->SetTouristPreset();
+    }
+    for (int minimum = 0; minimum < 2; ++minimum)
+    {
+      filter->SetMinimumSpanningTree(minimum != 0);
+      std::cout << (preset == 0 ? " express" : " tourist")
+        << (minimum ? ", minimum" : ", maximum") << std::endl;
+      same = CompareSpanningTrees(filter) && same;
+    }
+  }
+  for (int minimum = 0; minimum < 2; ++minimum)
+  {
+    std::cout << (minimum ? " tourist, minimum" : " tourist, maximum")
+      << std::endl;
+    same = CheckIncrementalUpdates(layout, minimum != 0) && same;
+  }
+  return same;
+}
+
+int main(int argc, char* argv[])
+{
+  const char* defaultFiles[] =
+  {
+    "../../Data/coauthorship.tlp",
+    "../../Data/graph_layout_view.tlp",
+    "../../Data/graph_layout_view_with_clusters.tlp",
+    "../../Data/marvel.tlp",
+    "../../Data/pvr.tlp",
+    "../../Data/subsampled_marvel.tlp",
+    "../../Data/ten_nodes.tlp",
+    "../../Data/test_graph.tlp"
+  };
+
+  vtkMath::RandomSeed(1010);
+  bool same = true;
+  if (argc > 1)
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      same = CheckGraph(argv[i]) && same;
+    }
+  }
+  else
+  {
+    int numFiles = sizeof(defaultFiles) / sizeof(defaultFiles[0]);
+    for (int i = 0; i < numFiles; ++i)
+    {
+      same = CheckGraph(defaultFiles[i]) && same;
+    }
+  }
+
+  return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -25,13 +25,13 @@
 #include "vtkDoubleArray.h"
 #include "vtkDirectedAcyclicGraph.h"
 #include "vtkEdgeListIterator.h"
-#include "vtkExtractSelectedGraph.h"
 #include "vtkFloatArray.h"
 #include "vtkIdList.h"
 #include "vtkIdTypeArray.h"
 #include "vtkInformation.h"
 #include "vtkInformationVector.h"
 #include "vtkIntArray.h"
+#include "vtkMultiThreader.h"
 #include "vtkMutableUndirectedGraph.h"
 #include "vtkObjectFactory.h"
 #include "vtkOutEdgeIterator.h"
@@ -39,13 +39,536 @@
 #include "vtkSelection.h"
 #include "vtkSelectionNode.h"
 #include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+#include "vtkUndirectedGraph.h"
 #include "vtkVariantArray.h"
 
+#include <algorithm>
 #include <map>
 #include <queue>
 #include <vector>
 
 
+//-----------------------------------------------------------------------------
+// Description:
+// Disjoint sets of vertices, for Kruskal's algorithm.
+class vtkFlightMapFilterDisjointSets
+{
+public:
+  vtkFlightMapFilterDisjointSets(vtkIdType numVertices) :
+      Parent(numVertices), Size(numVertices, 1)
+  {
+    for (vtkIdType i = 0; i < numVertices; ++i)
+    {
+      this->Parent[i] = i;
+    }
+  }
+
+  vtkIdType Find(vtkIdType v)
+  {
+    while (this->Parent[v] != v)
+    {
+      this->Parent[v] = this->Parent[this->Parent[v]];
+      v = this->Parent[v];
+    }
+    return v;
+  }
+
+  // Returns false if a and b were already in the same set.
+  bool Union(vtkIdType a, vtkIdType b)
+  {
+    a = this->Find(a);
+    b = this->Find(b);
+    if (a == b)
+    {
+      return false;
+    }
+    if (this->Size[a] < this->Size[b])
+    {
+      std::swap(a, b);
+    }
+    this->Parent[b] = a;
+    this->Size[a] += this->Size[b];
+    return true;
+  }
+
+private:
+  std::vector<vtkIdType> Parent;
+  std::vector<vtkIdType> Size;
+};
+
+//-----------------------------------------------------------------------------
+// Description:
+// Orders edge ids from most to least preferable for the spanning tree, ties
+// broken on id.
+class vtkFlightMapFilterCompareEdges
+{
+public:
+  vtkFlightMapFilterCompareEdges(const double* weights, bool minimum) :
+      Weights(weights), Minimum(minimum)
+  {
+  }
+
+  bool operator()(vtkIdType a, vtkIdType b) const
+  {
+    double wa = this->Minimum ? this->Weights[a] : -this->Weights[a];
+    double wb = this->Minimum ? this->Weights[b] : -this->Weights[b];
+    return wa < wb || (wa == wb && a < b);
+  }
+
+private:
+  const double* Weights;
+  bool Minimum;
+};
+
+// The fewest edges worth giving a thread of its own in the weighting pass.
+#define VTK_FLIGHT_MAP_MINIMUM_EDGES_PER_THREAD 50000
+
+//-----------------------------------------------------------------------------
+// Description:
+// The flat arrays read and written by the threads of the weighting pass.
+struct vtkFlightMapFilterWeightTask
+{
+  const vtkIdType* Sources;
+  const vtkIdType* Targets;
+  const double* Points;
+  const vtkIdType* Degrees;
+  const unsigned char* LandmarkMask;
+  double EdgeLengthFactor;
+  double EdgeDegreeFactor;
+  double EdgeLandmarkProximityFactor;
+  double DefaultWeight;
+  vtkIdType NumberOfEdges;
+  double* BaseWeights;
+  double* Weights;
+};
+
+//-----------------------------------------------------------------------------
+// Description:
+// Weight a contiguous block of edges, one block per thread.
+static VTK_THREAD_RETURN_TYPE vtkFlightMapFilterComputeWeights(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info =
+      static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  const vtkFlightMapFilterWeightTask* task =
+      static_cast<vtkFlightMapFilterWeightTask*>(info->UserData);
+
+  vtkIdType numEdges = task->NumberOfEdges;
+  vtkIdType begin = numEdges * info->ThreadID / info->NumberOfThreads;
+  vtkIdType end = numEdges * (info->ThreadID + 1) / info->NumberOfThreads;
+
+  double lengthScale = task->EdgeLengthFactor * 10.0;
+  double degreeScale = task->EdgeDegreeFactor * 10.0;
+  double landmarkScale = task->EdgeLandmarkProximityFactor * 50.0;
+  const double* points = task->Points;
+  for (vtkIdType e = begin; e < end; ++e)
+  {
+    vtkIdType s = task->Sources[e];
+    vtkIdType t = task->Targets[e];
+    double dx = points[3 * s] - points[3 * t];
+    double dy = points[3 * s + 1] - points[3 * t + 1];
+    double base = task->DefaultWeight
+        - sqrt(dx * dx + dy * dy) * lengthScale
+        - (task->Degrees[s] + task->Degrees[t]) * degreeScale;
+    task->BaseWeights[e] = base;
+    task->Weights[e] = base
+        - (task->LandmarkMask[s] + task->LandmarkMask[t]) * landmarkScale;
+  }
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+// True for edges that come before a given pivot edge in spanning tree order.
+class vtkFlightMapFilterBeforePivot
+{
+public:
+  vtkFlightMapFilterBeforePivot(const vtkFlightMapFilterCompareEdges& compare,
+      vtkIdType pivot) :
+      Compare(compare), Pivot(pivot)
+  {
+  }
+
+  bool operator()(vtkIdType e) const
+  {
+    return this->Compare(e, this->Pivot);
+  }
+
+private:
+  vtkFlightMapFilterCompareEdges Compare;
+  vtkIdType Pivot;
+};
+
+//-----------------------------------------------------------------------------
+// Description:
+// True for edges whose end points are already connected.
+class vtkFlightMapFilterClosesCycle
+{
+public:
+  vtkFlightMapFilterClosesCycle(vtkFlightMapFilterDisjointSets& sets,
+      const std::vector<vtkIdType>& sources,
+      const std::vector<vtkIdType>& targets) :
+      Sets(&sets), Sources(&sources), Targets(&targets)
+  {
+  }
+
+  bool operator()(vtkIdType e) const
+  {
+    return this->Sets->Find((*this->Sources)[e])
+        == this->Sets->Find((*this->Targets)[e]);
+  }
+
+private:
+  vtkFlightMapFilterDisjointSets* Sets;
+  const std::vector<vtkIdType>* Sources;
+  const std::vector<vtkIdType>* Targets;
+};
+
+//-----------------------------------------------------------------------------
+// Description:
+// A block of edge ids sorted by each thread of a parallel sort.
+struct vtkFlightMapFilterSortTask
+{
+  vtkIdType* Edges;
+  vtkIdType NumberOfEdges;
+  const vtkFlightMapFilterCompareEdges* Compare;
+};
+
+//-----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE vtkFlightMapFilterSortBlock(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info =
+      static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  const vtkFlightMapFilterSortTask* task =
+      static_cast<vtkFlightMapFilterSortTask*>(info->UserData);
+
+  vtkIdType begin =
+      task->NumberOfEdges * info->ThreadID / info->NumberOfThreads;
+  vtkIdType end =
+      task->NumberOfEdges * (info->ThreadID + 1) / info->NumberOfThreads;
+  std::sort(task->Edges + begin, task->Edges + end, *task->Compare);
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+// The working copy of the input and everything derived from it that survives
+// an annotation change.
+class vtkFlightMapFilterInternals
+{
+public:
+  // The input the working graph was copied from (compared, not referenced).
+  vtkGraph* Input;
+  vtkSmartPointer<vtkUndirectedGraph> Graph;
+
+  // The "weights" edge array of Graph, and the part of each weight that does
+  // not depend on the annotations.
+  vtkDoubleArray* Weights;
+  std::vector<double> BaseWeights;
+
+  // End points of each edge.
+  std::vector<vtkIdType> Sources;
+  std::vector<vtkIdType> Targets;
+
+  // The landmark vertices of the current and previous executions, as a list
+  // of unique ids and a byte per vertex.
+  std::vector<vtkIdType> Landmarks;
+  std::vector<unsigned char> LandmarkMask;
+  std::vector<vtkIdType> PreviousLandmarks;
+  std::vector<unsigned char> PreviousLandmarkMask;
+
+  // The spanning tree, as a flag per edge and a list of edge ids.
+  std::vector<char> InTree;
+  std::vector<vtkIdType> TreeEdges;
+
+  vtkTimeStamp BuildTime;
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Collect the vertices selected by the enabled annotations in one pass over
+  // their selection lists, keeping the previous set for comparison.
+  void GatherLandmarks(vtkAnnotationLayers* annotations,
+      vtkIdType numVertices, bool enabled)
+  {
+    this->PreviousLandmarks.swap(this->Landmarks);
+    this->PreviousLandmarkMask.swap(this->LandmarkMask);
+    this->Landmarks.clear();
+    this->LandmarkMask.assign(numVertices, 0);
+    if (!enabled || !annotations)
+    {
+      return;
+    }
+
+    unsigned int numAnnotations = annotations->GetNumberOfAnnotations();
+    for (unsigned int i = 0; i < numAnnotations; ++i)
+    {
+      vtkAnnotation* annotation = annotations->GetAnnotation(i);
+      if (!annotation->GetInformation()->Get(vtkAnnotation::ENABLE()))
+      {
+        continue;
+      }
+      vtkSelection* selection = annotation->GetSelection();
+      unsigned int numNodes = selection->GetNumberOfNodes();
+      for (unsigned int j = 0; j < numNodes; ++j)
+      {
+        vtkIdTypeArray* arr = vtkIdTypeArray::SafeDownCast(
+            selection->GetNode(j)->GetSelectionList());
+        vtkIdType numValues = arr ? arr->GetNumberOfTuples() : 0;
+        for (vtkIdType k = 0; k < numValues; ++k)
+        {
+          vtkIdType v = arr->GetValue(k);
+          if (v >= 0 && v < numVertices && !this->LandmarkMask[v])
+          {
+            this->LandmarkMask[v] = 1;
+            this->Landmarks.push_back(v);
+          }
+        }
+      }
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Restore the spanning tree after some tree edges got worse and some other
+  // edges got better. The new tree is found by Kruskal's algorithm over the
+  // old tree, the improved edges and, when a tree edge got worse, all edges
+  // joining the pieces the old tree falls into without the worsened edges.
+  // Any other edge closes a cycle of unchanged or improved tree edges on
+  // which it is still the worst, so it cannot belong to the new tree.
+  void RepairSpanningTree(const std::vector<vtkIdType>& worsened,
+      const std::vector<vtkIdType>& improved, bool minimum)
+  {
+    vtkIdType numVertices = this->Graph->GetNumberOfVertices();
+    vtkIdType numEdges = static_cast<vtkIdType>(this->InTree.size());
+
+    std::vector<vtkIdType> candidates(this->TreeEdges);
+    candidates.insert(candidates.end(), improved.begin(), improved.end());
+    if (!worsened.empty())
+    {
+      for (size_t i = 0; i < worsened.size(); ++i)
+      {
+        this->InTree[worsened[i]] = 0;
+      }
+      vtkFlightMapFilterDisjointSets pieces(numVertices);
+      for (size_t i = 0; i < this->TreeEdges.size(); ++i)
+      {
+        vtkIdType e = this->TreeEdges[i];
+        if (this->InTree[e])
+        {
+          pieces.Union(this->Sources[e], this->Targets[e]);
+        }
+      }
+      for (size_t i = 0; i < worsened.size(); ++i)
+      {
+        this->InTree[worsened[i]] = 1;
+      }
+      for (vtkIdType e = 0; e < numEdges; ++e)
+      {
+        if (!this->InTree[e]
+            && pieces.Find(this->Sources[e]) != pieces.Find(this->Targets[e]))
+        {
+          candidates.push_back(e);
+        }
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+        candidates.end());
+    std::sort(candidates.begin(), candidates.end(),
+        vtkFlightMapFilterCompareEdges(this->Weights->GetPointer(0), minimum));
+
+    vtkFlightMapFilterDisjointSets tree(numVertices);
+    for (size_t i = 0; i < this->TreeEdges.size(); ++i)
+    {
+      this->InTree[this->TreeEdges[i]] = 0;
+    }
+    this->TreeEdges.clear();
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+      vtkIdType e = candidates[i];
+      if (tree.Union(this->Sources[e], this->Targets[e]))
+      {
+        this->InTree[e] = 1;
+        this->TreeEdges.push_back(e);
+      }
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Find the spanning tree with filter-Kruskal: split the edges about a
+  // pivot, build the tree from the preferable half first, then drop every
+  // edge of the other half that would close a cycle before handling what is
+  // left of it. Ranges up to the size of the graph are sorted (in parallel
+  // when large) and scanned as in plain Kruskal.
+  void FindSpanningTree(bool minimum, vtkMultiThreader* threader)
+  {
+    vtkIdType numVertices = this->Graph->GetNumberOfVertices();
+    vtkIdType numEdges = static_cast<vtkIdType>(this->Sources.size());
+    this->InTree.assign(numEdges, 0);
+    this->TreeEdges.clear();
+    if (numEdges == 0)
+    {
+      return;
+    }
+
+    std::vector<vtkIdType> edges(numEdges);
+    for (vtkIdType e = 0; e < numEdges; ++e)
+    {
+      edges[e] = e;
+    }
+    vtkFlightMapFilterCompareEdges compare(this->Weights->GetPointer(0),
+        minimum);
+    vtkFlightMapFilterDisjointSets sets(numVertices);
+    vtkIdType baseSize = std::max<vtkIdType>(numVertices, 4096);
+    this->FilterKruskal(&edges[0], &edges[0] + numEdges, baseSize, compare,
+        sets, threader);
+  }
+
+  //---------------------------------------------------------------------------
+  void FilterKruskal(vtkIdType* begin, vtkIdType* end, vtkIdType baseSize,
+      const vtkFlightMapFilterCompareEdges& compare,
+      vtkFlightMapFilterDisjointSets& sets, vtkMultiThreader* threader)
+  {
+    if (end - begin > baseSize)
+    {
+      // The median of three distinct edges always has one edge before it.
+      vtkIdType a = begin[0];
+      vtkIdType b = begin[(end - begin) / 2];
+      vtkIdType c = end[-1];
+      vtkIdType pivot = compare(a, b) ?
+          (compare(b, c) ? b : (compare(a, c) ? c : a)) :
+          (compare(a, c) ? a : (compare(b, c) ? c : b));
+      vtkIdType* middle = std::partition(begin, end,
+          vtkFlightMapFilterBeforePivot(compare, pivot));
+      if (middle != begin && middle != end)
+      {
+        this->FilterKruskal(begin, middle, baseSize, compare, sets,
+            threader);
+        vtkIdType* remaining = std::remove_if(middle, end,
+            vtkFlightMapFilterClosesCycle(sets, this->Sources,
+                this->Targets));
+        this->FilterKruskal(middle, remaining, baseSize, compare, sets,
+            threader);
+        return;
+      }
+    }
+
+    this->SortEdges(begin, end, compare, threader);
+    for (vtkIdType* e = begin; e != end; ++e)
+    {
+      if (sets.Union(this->Sources[*e], this->Targets[*e]))
+      {
+        this->InTree[*e] = 1;
+        this->TreeEdges.push_back(*e);
+      }
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Sort blocks of the range in parallel, then merge them pairwise.
+  void SortEdges(vtkIdType* begin, vtkIdType* end,
+      const vtkFlightMapFilterCompareEdges& compare, vtkMultiThreader* threader)
+  {
+    vtkIdType numEdges = static_cast<vtkIdType>(end - begin);
+    int numThreads = static_cast<int>(std::min<vtkIdType>(
+        threader->GetGlobalDefaultNumberOfThreads(),
+        numEdges / VTK_FLIGHT_MAP_MINIMUM_EDGES_PER_THREAD + 1));
+    if (numThreads < 2)
+    {
+      std::sort(begin, end, compare);
+      return;
+    }
+
+    vtkFlightMapFilterSortTask task;
+    task.Edges = begin;
+    task.NumberOfEdges = numEdges;
+    task.Compare = &compare;
+    threader->SetNumberOfThreads(numThreads);
+    threader->SetSingleMethod(vtkFlightMapFilterSortBlock, &task);
+    threader->SingleMethodExecute();
+
+    for (int width = 1; width < numThreads; width *= 2)
+    {
+      for (int i = 0; i + width < numThreads; i += 2 * width)
+      {
+        int last = std::min(i + 2 * width, numThreads);
+        std::inplace_merge(begin + numEdges * i / numThreads,
+            begin + numEdges * (i + width) / numThreads,
+            begin + numEdges * last / numThreads, compare);
+      }
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Root each tree of the spanning forest at its lowest numbered vertex and
+  // record the parent of every vertex and the index in TreeEdges of the edge
+  // to it (-1 at the roots).
+  void ComputeParents(std::vector<vtkIdType>& parent,
+      std::vector<vtkIdType>& parentEdge) const
+  {
+    vtkIdType numVertices = this->Graph->GetNumberOfVertices();
+    vtkIdType numTreeEdges = static_cast<vtkIdType>(this->TreeEdges.size());
+
+    // Adjacency of the tree, as offsets into a list of tree edge indices.
+    std::vector<vtkIdType> offsets(numVertices + 1, 0);
+    for (vtkIdType i = 0; i < numTreeEdges; ++i)
+    {
+      ++offsets[this->Sources[this->TreeEdges[i]] + 1];
+      ++offsets[this->Targets[this->TreeEdges[i]] + 1];
+    }
+    for (vtkIdType v = 0; v < numVertices; ++v)
+    {
+      offsets[v + 1] += offsets[v];
+    }
+    std::vector<vtkIdType> incident(2 * numTreeEdges);
+    std::vector<vtkIdType> fill(offsets.begin(), offsets.end() - 1);
+    for (vtkIdType i = 0; i < numTreeEdges; ++i)
+    {
+      incident[fill[this->Sources[this->TreeEdges[i]]]++] = i;
+      incident[fill[this->Targets[this->TreeEdges[i]]]++] = i;
+    }
+
+    parent.assign(numVertices, -1);
+    parentEdge.assign(numVertices, -1);
+    std::vector<char> visited(numVertices, 0);
+    std::vector<vtkIdType> queue;
+    queue.reserve(numVertices);
+    for (vtkIdType root = 0; root < numVertices; ++root)
+    {
+      if (visited[root])
+      {
+        continue;
+      }
+      visited[root] = 1;
+      queue.clear();
+      queue.push_back(root);
+      for (size_t head = 0; head < queue.size(); ++head)
+      {
+        vtkIdType u = queue[head];
+        for (vtkIdType j = offsets[u]; j < offsets[u + 1]; ++j)
+        {
+          vtkIdType i = incident[j];
+          vtkIdType e = this->TreeEdges[i];
+          vtkIdType v = this->Sources[e] == u ?
+              this->Targets[e] : this->Sources[e];
+          if (!visited[v])
+          {
+            visited[v] = 1;
+            parent[v] = u;
+            parentEdge[v] = i;
+            queue.push_back(v);
+          }
+        }
+      }
+    }
+  }
+};
+
 vtkStandardNewMacro(vtkFlightMapFilter)
 
 //-----------------------------------------------------------------------------
@@ -57,21 +580,26 @@ vtkFlightMapFilter::vtkFlightMapFilter()
   this->MinimumSpanningTree = true;
   this->Kruskal->SetNegateEdgeWeights(false);
 
-  this->ExtractKruskalSelection =
-      vtkSmartPointer<vtkExtractSelectedGraph>::New();
-  this->ExtractKruskalSelection->SetRemoveIsolatedVertices(false);
-  this->ExtractKruskalSelection->SetSelectionConnection(
-      this->Kruskal->GetOutputPort());
 
   this->EdgeLengthFactor = 1.0;
   this->EdgeDegreeFactor = 1.0;
   this->EdgeLandmarkProximityFactor = 1.0;
+  this->IncrementalUpdates = true;
+  this->SpanningTreeBackend = vtkFlightMapFilter::BoostKruskal;
+  this->Threader = vtkSmartPointer<vtkMultiThreader>::New();
+  this->LastUpdateWasIncremental = false;
+  this->WeightingTime = 0.0;
+  this->NumberOfWeightingThreads = 0;
+
+  this->Internals = new vtkFlightMapFilterInternals;
+  this->Internals->Input = 0;
+  this->Internals->Weights = 0;
 }
 
 //-----------------------------------------------------------------------------
 vtkFlightMapFilter::~vtkFlightMapFilter()
 {
-  //
+  delete this->Internals;
 }
 
 //-----------------------------------------------------------------------------
@@ -122,6 +650,18 @@ void vtkFlightMapFilter::SetTouristPreset()
   this->SetMinimumSpanningTree(false);
 }
 
+//-----------------------------------------------------------------------------
+void vtkFlightMapFilter::SetSpanningTreeBackendToBoostKruskal()
+{
+  this->SetSpanningTreeBackend(vtkFlightMapFilter::BoostKruskal);
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapFilter::SetSpanningTreeBackendToFilterKruskal()
+{
+  this->SetSpanningTreeBackend(vtkFlightMapFilter::FilterKruskal);
+}
+
 //-----------------------------------------------------------------------------
 int vtkFlightMapFilter::RequestData(vtkInformation *vtkNotUsed(request),
     vtkInformationVector **inputVector, vtkInformationVector *outputVector)
@@ -141,130 +681,302 @@ int vtkFlightMapFilter::RequestData(vtkInformation *vtkNotUsed(request),
   vtkGraph *outputGraph = vtkGraph::SafeDownCast(
       outInfo0->Get(vtkDataObject::DATA_OBJECT()));
 
-  // Copy input graph into a mutable
-  vtkSmartPointer<vtkMutableUndirectedGraph> mutableGraph = vtkSmartPointer<
+  // Gather up all annotated vertices.
+  vtkFlightMapFilterInternals* internals = this->Internals;
+  internals->GatherLandmarks(inputAnnotation,
+      inputGraph->GetNumberOfVertices(),
+      this->EdgeLandmarkProximityFactor > 0.0);
+
+  // Anything but an annotation change invalidates the previous flight map.
+  // The repair orders tied edges as filter-Kruskal does, not as Boost does.
+  vtkPoints* inputPoints = inputGraph->GetPoints();
+  this->LastUpdateWasIncremental = this->IncrementalUpdates
+      && this->SpanningTreeBackend == vtkFlightMapFilter::FilterKruskal
+      && internals->Graph
+      && internals->Input == inputGraph
+      && inputGraph->GetMTime() <= internals->BuildTime
+      && (!inputPoints || inputPoints->GetMTime() <= internals->BuildTime)
+      && this->GetMTime() <= internals->BuildTime;
+  if (this->LastUpdateWasIncremental)
+  {
+    this->UpdateFlightMap();
+  }
+  else
+  {
+    this->BuildFlightMap(inputGraph);
+  }
+  internals->BuildTime.Modified();
+
+  //// Build the tree: every vertex, the tree edges with their edge points,
+  //// and their weights.
+  vtkGraph* graph = internals->Graph;
+  vtkIdType numVertices = graph->GetNumberOfVertices();
+  vtkIdType numTreeEdges = static_cast<vtkIdType>(internals->TreeEdges.size());
+  vtkSmartPointer<vtkMutableUndirectedGraph> tree = vtkSmartPointer<
       vtkMutableUndirectedGraph>::New();
-  mutableGraph->DeepCopy(inputGraph);
+  tree->SetNumberOfVertices(numVertices);
+  tree->SetPoints(graph->GetPoints());
+
+  vtkDoubleArray* treeWeights = vtkDoubleArray::New();
+  treeWeights->SetName("weights");
+  treeWeights->SetNumberOfValues(numTreeEdges);
+  for (vtkIdType i = 0; i < numTreeEdges; ++i)
+  {
+    vtkIdType e = internals->TreeEdges[i];
+    vtkEdgeType edge = tree->AddEdge(internals->Sources[e],
+        internals->Targets[e]);
+    treeWeights->SetValue(edge.Id, internals->Weights->GetValue(e));
+
+    vtkIdType npts;
+    double* pts;
+    graph->GetEdgePoints(e, npts, pts);
+    if (npts > 0)
+    {
+      tree->SetEdgePoints(edge.Id, npts, pts);
+    }
+  }
+  tree->GetEdgeData()->AddArray(treeWeights);
+  treeWeights->Delete();
+
+  // The tree as a parent array, with the (output) id of the edge to each
+  // parent.
+  std::vector<vtkIdType> parent;
+  std::vector<vtkIdType> parentEdge;
+  internals->ComputeParents(parent, parentEdge);
+  vtkIdTypeArray* parentArray = vtkIdTypeArray::New();
+  parentArray->SetName("parent");
+  parentArray->SetNumberOfValues(numVertices);
+  vtkIdTypeArray* parentEdgeArray = vtkIdTypeArray::New();
+  parentEdgeArray->SetName("parent edge");
+  parentEdgeArray->SetNumberOfValues(numVertices);
+  for (vtkIdType v = 0; v < numVertices; ++v)
+  {
+    parentArray->SetValue(v, parent[v]);
+    parentEdgeArray->SetValue(v, parentEdge[v]);
+  }
+  tree->GetVertexData()->AddArray(parentArray);
+  tree->GetVertexData()->AddArray(parentEdgeArray);
+  parentArray->Delete();
+  parentEdgeArray->Delete();
+
+  // Copy results to output
+  if (!outputGraph->CheckedShallowCopy(tree))
+  {
+    vtkErrorMacro(
+        << "Error creating flight map: invalid output graph structure.");
+    return 0;
+  }
+
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapFilter::BuildFlightMap(vtkGraph* inputGraph)
+{
+  vtkFlightMapFilterInternals* internals = this->Internals;
+  internals->Input = inputGraph;
+
+  // Share the structure and attributes of the input; only the points and
+  // the weights belong to the working graph.
+  vtkSmartPointer<vtkUndirectedGraph> workingGraph = vtkSmartPointer<
+      vtkUndirectedGraph>::New();
+  workingGraph->ShallowCopy(inputGraph);
+  internals->Graph = workingGraph;
 
   // Flatten the points into 2D
   double p[3];
-  vtkPoints* inputPoints = mutableGraph->GetPoints();
-  for (vtkIdType i = 0; i < inputPoints->GetNumberOfPoints(); ++i)
+  vtkPoints* sourcePoints = inputGraph->GetPoints();
+  vtkIdType numPoints = sourcePoints ? sourcePoints->GetNumberOfPoints() : 0;
+  vtkPoints* inputPoints = vtkPoints::New();
+  inputPoints->SetDataTypeToDouble();
+  inputPoints->SetNumberOfPoints(numPoints);
+  for (vtkIdType i = 0; i < numPoints; ++i)
   {
-    inputPoints->GetPoint(i, p);
+    sourcePoints->GetPoint(i, p);
     p[2] = 0.0;
     inputPoints->SetPoint(i, p);
   }
+  workingGraph->SetPoints(inputPoints);
+  inputPoints->Delete();
+
+  //// Flatten the edge list and vertex degrees for the weighting pass.
+  vtkIdType numEdges = workingGraph->GetNumberOfEdges();
+  vtkIdType numVertices = workingGraph->GetNumberOfVertices();
+  internals->Sources.resize(numEdges);
+  internals->Targets.resize(numEdges);
+  internals->BaseWeights.resize(numEdges);
+
+  vtkEdgeListIterator* edges = vtkEdgeListIterator::New();
+  workingGraph->GetEdges(edges);
+  while (edges->HasNext())
+  {
+    vtkEdgeType edge = edges->Next();
+    internals->Sources[edge.Id] = edge.Source;
+    internals->Targets[edge.Id] = edge.Target;
+  }
+  edges->Delete();
+
+  std::vector<vtkIdType> degrees(numVertices);
+  for (vtkIdType v = 0; v < numVertices; ++v)
+  {
+    degrees[v] = workingGraph->GetDegree(v);
+  }
 
-  //// Initialize and add default edge weights.
-  vtkIdType numEdges = mutableGraph->GetNumberOfEdges();
+  //// Weight by edge length, degree and proximity to landmarks in one pass,
+  //// split across threads. The length and degree terms are also kept in
+  //// BaseWeights, they only change with the graph.
   vtkDoubleArray* weights = vtkDoubleArray::New();
   weights->SetName("weights");
   weights->SetNumberOfValues(numEdges);
-  for (vtkIdType i = 0; i < numEdges; ++i)
+
+  double weightingStart = vtkTimerLog::GetUniversalTime();
+  this->NumberOfWeightingThreads = 0;
+  if (numEdges > 0)
   {
-    weights->SetValue(i, vtkFlightMapFilter::DefaultWeight);
+    vtkFlightMapFilterWeightTask task;
+    task.Sources = &internals->Sources[0];
+    task.Targets = &internals->Targets[0];
+    task.Points = static_cast<double*>(inputPoints->GetVoidPointer(0));
+    task.Degrees = &degrees[0];
+    task.LandmarkMask = &internals->LandmarkMask[0];
+    task.EdgeLengthFactor = this->EdgeLengthFactor;
+    task.EdgeDegreeFactor = this->EdgeDegreeFactor;
+    task.EdgeLandmarkProximityFactor = this->EdgeLandmarkProximityFactor;
+    task.DefaultWeight = vtkFlightMapFilter::DefaultWeight;
+    task.NumberOfEdges = numEdges;
+    task.BaseWeights = &internals->BaseWeights[0];
+    task.Weights = weights->GetPointer(0);
+
+    // Small graphs are not worth the thread start-up.
+    int numThreads = static_cast<int>(std::min<vtkIdType>(
+        this->Threader->GetGlobalDefaultNumberOfThreads(),
+        numEdges / VTK_FLIGHT_MAP_MINIMUM_EDGES_PER_THREAD + 1));
+    this->Threader->SetNumberOfThreads(numThreads);
+    this->Threader->SetSingleMethod(vtkFlightMapFilterComputeWeights, &task);
+    this->Threader->SingleMethodExecute();
+    this->NumberOfWeightingThreads = numThreads;
   }
+  this->WeightingTime = vtkTimerLog::GetUniversalTime() - weightingStart;
+  workingGraph->GetEdgeData()->AddArray(weights);
+  internals->Weights = weights;
+  weights->Delete();
 
-  //// Weight by edge length.
-  vtkEdgeListIterator* edges = vtkEdgeListIterator::New();
-  if (this->EdgeLengthFactor > 0.0)
+  //// Find MST
+  if (this->SpanningTreeBackend == vtkFlightMapFilter::FilterKruskal)
+  {
+    internals->FindSpanningTree(this->MinimumSpanningTree, this->Threader);
+    return;
+  }
+
+  this->Kruskal->SetNegateEdgeWeights(!this->MinimumSpanningTree);
+  this->Kruskal->SetInput(workingGraph);
+  this->Kruskal->SetEdgeWeightArrayName("weights");
+  this->Kruskal->Update();
+
+  internals->InTree.assign(numEdges, 0);
+  internals->TreeEdges.clear();
+  vtkSelection* kruskalSelection = this->Kruskal->GetOutput();
+  for (unsigned int i = 0; i < kruskalSelection->GetNumberOfNodes(); ++i)
   {
-    mutableGraph->GetEdges(edges);
-    while (edges->HasNext())
+    vtkIdTypeArray* list = vtkIdTypeArray::SafeDownCast(
+        kruskalSelection->GetNode(i)->GetSelectionList());
+    vtkIdType numValues = list ? list->GetNumberOfTuples() : 0;
+    for (vtkIdType j = 0; j < numValues; ++j)
     {
-      vtkEdgeType edge = edges->Next();
-      double weight = sqrt(
-          (inputPoints->GetPoint(edge.Source)[0] -
-          inputPoints->GetPoint(edge.Target)[0]) *
-          (inputPoints->GetPoint(edge.Source)[0] -
-          inputPoints->GetPoint(edge.Target)[0]) +
-          (inputPoints->GetPoint(edge.Source)[1] -
-          inputPoints->GetPoint(edge.Target)[1]) *
-          (inputPoints->GetPoint(edge.Source)[1] -
-          inputPoints->GetPoint(edge.Target)[1]));
-      weights->SetValue(edge.Id,
-          weights->GetValue(edge.Id)
-          - (weight * this->EdgeLengthFactor * 10.0));
+      internals->InTree[list->GetValue(j)] = 1;
+      internals->TreeEdges.push_back(list->GetValue(j));
     }
   }
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapFilter::UpdateFlightMap()
+{
+  vtkFlightMapFilterInternals* internals = this->Internals;
 
-  //// Weight by degree.
-  if (this->EdgeDegreeFactor > 0.0)
+  // Vertices that joined or left a landmark.
+  std::vector<vtkIdType> changedVertices;
+  for (size_t i = 0; i < internals->PreviousLandmarks.size(); ++i)
   {
-    mutableGraph->GetEdges(edges);
-    while (edges->HasNext())
+    vtkIdType v = internals->PreviousLandmarks[i];
+    if (!internals->LandmarkMask[v])
     {
-      vtkEdgeType edge = edges->Next();
-      double weight = mutableGraph->GetDegree(edge.Source)
-              + mutableGraph->GetDegree(edge.Target);
-      weights->SetValue(edge.Id,
-          weights->GetValue(edge.Id)
-          - (weight * this->EdgeDegreeFactor * 10.0));
+      changedVertices.push_back(v);
     }
   }
-
-  //// Weight by proximity to landmarks.
-  if (this->EdgeLandmarkProximityFactor > 0.0)
+  for (size_t i = 0; i < internals->Landmarks.size(); ++i)
   {
-    // Gather up all annotation ids.
-    vtkIdTypeArray* ids = vtkIdTypeArray::New();
-    unsigned int numAnnotations = inputAnnotation->GetNumberOfAnnotations();
-    for (unsigned int i = 0; i < numAnnotations; ++i)
+    vtkIdType v = internals->Landmarks[i];
+    if (!internals->PreviousLandmarkMask[v])
     {
-      vtkAnnotation* annotation = inputAnnotation->GetAnnotation(i);
-      if (annotation->GetInformation()->Get(vtkAnnotation::ENABLE()))
-      {
-        vtkSelection* selection =
-            inputAnnotation->GetAnnotation(i)->GetSelection();
-        unsigned int numNodes = selection->GetNumberOfNodes();
-        for (unsigned int j = 0; j < numNodes; ++j)
-        {
-          vtkSelectionNode* node = selection->GetNode(j);
-          vtkIdTypeArray* arr = vtkIdTypeArray::SafeDownCast(
-              node->GetSelectionList());
-          vtkIdType numValues = arr->GetNumberOfTuples();
-          for (vtkIdType k = 0; k < numValues; ++k)
-          {
-            ids->InsertNextValue(arr->GetValue(k));
-          }
-        }
-      }
+      changedVertices.push_back(v);
     }
+  }
+  if (changedVertices.empty())
+  {
+    return;
+  }
 
-    mutableGraph->GetEdges(edges);
-    while (edges->HasNext())
+  // Their incident edges.
+  std::vector<vtkIdType> changedEdges;
+  vtkOutEdgeIterator* incident = vtkOutEdgeIterator::New();
+  for (size_t i = 0; i < changedVertices.size(); ++i)
+  {
+    internals->Graph->GetOutEdges(changedVertices[i], incident);
+    while (incident->HasNext())
     {
-      vtkEdgeType edge = edges->Next();
-      double weight = (ids->LookupValue(edge.Source) >= 0)
-              + (ids->LookupValue(edge.Source) >= 0);
-      weights->SetValue(edge.Id,
-          weights->GetValue(edge.Id)
-          - (weight * this->EdgeLandmarkProximityFactor * 50.0));
+      changedEdges.push_back(incident->Next().Id);
     }
-    ids->Delete();
   }
-  mutableGraph->GetEdgeData()->AddArray(weights);
-  edges->Delete();
-  weights->Delete();
-
-  //// Find MST
-  this->Kruskal->SetNegateEdgeWeights(!this->MinimumSpanningTree);
-  this->Kruskal->SetInput(mutableGraph);
-  this->Kruskal->SetEdgeWeightArrayName("weights");
-  this->ExtractKruskalSelection->SetInput(mutableGraph);
-  this->ExtractKruskalSelection->Update();
+  incident->Delete();
+  std::sort(changedEdges.begin(), changedEdges.end());
+  changedEdges.erase(std::unique(changedEdges.begin(), changedEdges.end()),
+      changedEdges.end());
+
+  // Re-weight them, noting the tree edges that got worse and the other edges
+  // that got better. Nothing else can change the spanning tree.
+  std::vector<vtkIdType> worsened;
+  std::vector<vtkIdType> improved;
+  vtkDoubleArray* weights = internals->Weights;
+  for (size_t i = 0; i < changedEdges.size(); ++i)
+  {
+    vtkIdType e = changedEdges[i];
+    double oldWeight = weights->GetValue(e);
+    double newWeight = internals->BaseWeights[e]
+        - this->GetLandmarkProximityWeight(e);
+    if (newWeight == oldWeight)
+    {
+      continue;
+    }
+    weights->SetValue(e, newWeight);
+    bool better = this->MinimumSpanningTree ?
+        newWeight < oldWeight : newWeight > oldWeight;
+    if (internals->InTree[e] && !better)
+    {
+      worsened.push_back(e);
+    }
+    else if (!internals->InTree[e] && better)
+    {
+      improved.push_back(e);
+    }
+  }
+  weights->Modified();
 
-  // Copy results to output
-  vtkGraph* mstGraph = this->ExtractKruskalSelection->GetOutput();
-  if (!outputGraph->CheckedShallowCopy(mstGraph))
+  if (!worsened.empty() || !improved.empty())
   {
-    vtkErrorMacro(
-        << "Error creating flight map: invalid output graph structure.");
-    return 0;
+    internals->RepairSpanningTree(worsened, improved,
+        this->MinimumSpanningTree);
   }
+}
 
-  return 1;
+//-----------------------------------------------------------------------------
+double vtkFlightMapFilter::GetLandmarkProximityWeight(vtkIdType edgeId)
+{
+  const std::vector<unsigned char>& mask = this->Internals->LandmarkMask;
+  double weight = mask[this->Internals->Sources[edgeId]]
+      + mask[this->Internals->Targets[edgeId]];
+  // Rounded exactly as in the weighting pass of a full build.
+  return weight * (this->EdgeLandmarkProximityFactor * 50.0);
 }
 
 //-----------------------------------------------------------------------------
@@ -277,4 +989,14 @@ void vtkFlightMapFilter::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "EdgeDegreeFactor: " << this->EdgeDegreeFactor << endl;
   os << indent << "EdgeLandmarkProximityFactor: " <<
       this->EdgeLandmarkProximityFactor << endl;
+  os << indent << "SpanningTreeBackend: " <<
+      (this->SpanningTreeBackend == vtkFlightMapFilter::BoostKruskal ?
+          "BoostKruskal" : "FilterKruskal") << endl;
+  os << indent << "IncrementalUpdates: " <<
+      (this->IncrementalUpdates ? "On" : "Off") << endl;
+  os << indent << "LastUpdateWasIncremental: " <<
+      (this->LastUpdateWasIncremental ? "On" : "Off") << endl;
+  os << indent << "WeightingTime: " << this->WeightingTime << endl;
+  os << indent << "NumberOfWeightingThreads: " <<
+      this->NumberOfWeightingThreads << endl;
 }
@@ -23,10 +23,36 @@
 // spanning tree of the weighted graph, with a choice between the maximum or
 // minimum weight span.
 //
+// The input is not copied. The filter works on a shallow copy of it that owns
+// only a flattened (z = 0) copy of the points and the "weights" edge array.
+// The output holds just what routing needs: every vertex with its flattened
+// point, and the tree edges with their edge points and weights. Other vertex
+// and edge attributes of the input are not passed through. The vertex data
+// of the output also describes the tree as a "parent" array (-1 at the root
+// of each component) and a "parent edge" array holding the output id of the
+// edge to the parent.
+//
+// The three weight terms are computed together in one pass over flat arrays
+// of edge end points, vertex coordinates and degrees, divided between the
+// threads of a vtkMultiThreader on large graphs.
+//
 // The filter is used in CoronaScope to calculate a 'flight path' along which to
 // move the camera in automated pan and zoom. Two presets modes, 'express' and
 // 'tourist' are provided.
 //
+// Annotation edits only change the landmark proximity term of the edges
+// incident to vertices that joined or left an annotation. With
+// IncrementalUpdates on (the default) the filter keeps its working graph, the
+// length and degree part of every weight and the spanning tree between
+// executions. When only the annotations have changed it re-weights just the
+// affected edges and repairs the tree with a Kruskal pass over the old tree,
+// the re-weighted edges and (if a tree edge got worse) the edges that could
+// replace it. A change to the graph, its points or any parameter of this
+// filter still triggers a full rebuild. The repair breaks ties between equal
+// weights on the edge id, as the filter-Kruskal backend does, so it is only
+// used with that backend; with BoostKruskal every execution is a full
+// rebuild, as Boost's tie-breaking cannot be reproduced.
+//
 // .SEE ALSO
 //
 
@@ -37,8 +63,11 @@
 #include "vtkUndirectedGraphAlgorithm.h"
 #include "vtkSmartPointer.h" // for class ivars
 
-class vtkExtractSelectedGraph;
+// Private class holding the state kept between executions.
+class vtkFlightMapFilterInternals;
+
 class vtkBoostKruskalMinimumSpanningTree;
+class vtkMultiThreader;
 
 
 class VTK_CSM_INFOVIS_EXPORT vtkFlightMapFilter:
@@ -77,6 +106,42 @@ public:
   void SetExpressPreset();
   void SetTouristPreset();
 
+  // Description:
+  // Choose how the spanning tree is found: with
+  // vtkBoostKruskalMinimumSpanningTree, kept as the reference
+  // implementation, or natively with a filter-Kruskal whose sorts run in
+  // parallel. Both find a tree of the same total weight, though they may
+  // break ties differently (the SpanningTreeCheck example compares them).
+  // Default BoostKruskal.
+  enum
+  {
+    BoostKruskal = 0, FilterKruskal
+  };
+  vtkSetClampMacro(SpanningTreeBackend, int, BoostKruskal, FilterKruskal)
+  vtkGetMacro(SpanningTreeBackend, int)
+  void SetSpanningTreeBackendToBoostKruskal();
+  void SetSpanningTreeBackendToFilterKruskal();
+
+  // Description:
+  // When set, executions caused only by annotation changes update the
+  // previous flight map instead of rebuilding it, giving the same output as
+  // a rebuild would. Only used with the FilterKruskal backend. Default on.
+  vtkSetMacro(IncrementalUpdates, bool)
+  vtkGetMacro(IncrementalUpdates, bool)
+  vtkBooleanMacro(IncrementalUpdates, bool)
+
+  // Description:
+  // Whether the last execution updated the previous flight map.
+  vtkGetMacro(LastUpdateWasIncremental, bool)
+
+  // Description:
+  // The time (in seconds) the last full build spent weighting the edges, and
+  // the number of threads it was split across. Small graphs are weighted on
+  // one thread; larger ones on up to the global default number of threads
+  // of vtkMultiThreader.
+  vtkGetMacro(WeightingTime, double)
+  vtkGetMacro(NumberOfWeightingThreads, int)
+
 protected:
   vtkFlightMapFilter();
   ~vtkFlightMapFilter();
@@ -92,6 +157,21 @@ protected:
   // Set the output type of the algorithm to vtkGraph
   int FillOutputPortInformation(int port, vtkInformation *info);
 
+  // Description:
+  // Copy the input and compute every weight and the spanning tree from
+  // scratch.
+  void BuildFlightMap(vtkGraph* input);
+
+  // Description:
+  // Re-weight the edges incident to vertices whose landmark status changed
+  // and repair the spanning tree.
+  void UpdateFlightMap();
+
+  // Description:
+  // The landmark proximity term subtracted from the weight of an edge: one
+  // share for each end point that is a landmark.
+  double GetLandmarkProximityWeight(vtkIdType edgeId);
+
 private:
   vtkFlightMapFilter(const vtkFlightMapFilter&);  // Not implemented.
   void operator=(const vtkFlightMapFilter&);  // Not implemented.
@@ -102,9 +182,16 @@ private:
   double EdgeLengthFactor;
   double EdgeDegreeFactor;
   double EdgeLandmarkProximityFactor;
+  int SpanningTreeBackend;
+  bool IncrementalUpdates;
+  bool LastUpdateWasIncremental;
+  double WeightingTime;
+  int NumberOfWeightingThreads;
 
   vtkSmartPointer<vtkBoostKruskalMinimumSpanningTree> Kruskal;
-  vtkSmartPointer<vtkExtractSelectedGraph> ExtractKruskalSelection;
+  vtkSmartPointer<vtkMultiThreader> Threader;
+
+  vtkFlightMapFilterInternals* Internals;
 };
 
 const double vtkFlightMapFilter::DefaultWeight = 1500.0;
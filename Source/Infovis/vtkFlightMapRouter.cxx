@@ -0,0 +1,1020 @@
+/*=========================================================================
+
+ Program:   Visualization Toolkit
+ Module:    vtkFlightMapRouter.cxx
+
+ Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+ All rights reserved.
+ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+ =========================================================================*/
+
+#include "vtkFlightMapRouter.h"
+
+#include "vtkCommand.h"
+#include "vtkDataArray.h"
+#include "vtkDataSetAttributes.h"
+#include "vtkGraph.h"
+#include "vtkIdList.h"
+#include "vtkObjectFactory.h"
+#include "vtkOutEdgeIterator.h"
+#include "vtkPoints.h"
+#include "vtkUndirectedGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// The number of vertices settled between progress events.
+#define VTK_FLIGHT_MAP_ROUTER_PROGRESS_INTERVAL 4096
+
+//-----------------------------------------------------------------------------
+// Description:
+// Orders vertex ids by one coordinate, for building the kd-tree.
+class vtkFlightMapRouterCompareCoordinate
+{
+public:
+  vtkFlightMapRouterCompareCoordinate(const double* points, int axis) :
+      Points(points), Axis(axis)
+  {
+  }
+
+  bool operator()(vtkIdType a, vtkIdType b) const
+  {
+    return this->Points[2 * a + this->Axis] < this->Points[2 * b + this->Axis];
+  }
+
+private:
+  const double* Points;
+  int Axis;
+};
+
+//-----------------------------------------------------------------------------
+// Description:
+// The CSR snapshot of the graph plus the state of the most recent search. The
+// search arrays are sized once per snapshot and only the entries touched by a
+// search are reset, so repeated queries do no allocation.
+class vtkFlightMapRouterInternals
+{
+public:
+  // Heap positions of vertices that are not in the heap.
+  enum
+  {
+    Unvisited = -1, Settled = -2
+  };
+
+  // A shortest-path tree rooted at a destination vertex. Following Parent
+  // from any vertex leads to the root along a shortest path. Use is the
+  // position of the root in RouteUse.
+  struct RouteTree
+  {
+    std::vector<vtkIdType> Parent;
+    std::vector<vtkIdType> ParentEdge;
+    std::list<vtkIdType>::iterator Use;
+  };
+
+  // What the snapshot was built from. The graph is not referenced, the
+  // pointer is only compared.
+  vtkGraph* SnapshotGraph;
+  std::string SnapshotWeightArrayName;
+  bool Undirected;
+
+  // The CSR snapshot. The neighbours of vertex v are
+  // Neighbours[Offsets[v]] ... Neighbours[Offsets[v + 1] - 1].
+  std::vector<vtkIdType> Offsets;
+  std::vector<vtkIdType> Neighbours;
+  std::vector<vtkIdType> EdgeIds;
+  std::vector<double> Weights;
+
+  // Vertex coordinates (x, y interleaved) and the A* heuristic scale.
+  std::vector<double> Points;
+  double HeuristicScale;
+
+  // The kd-tree over Points. The node for the range [lo, hi) of KdOrder is
+  // the vertex at the middle of the range; the vertices before it are on the
+  // low side of its splitting line, those after it on the high side. Splits
+  // alternate between x (even depths) and y. KdBounds is the bounding box
+  // (xmin, xmax, ymin, ymax) of all the points.
+  std::vector<vtkIdType> KdOrder;
+  double KdBounds[4];
+
+  // Search state, one entry per vertex. Key is the heap priority: the
+  // distance, plus the heuristic estimate to the target for A*.
+  std::vector<double> Distance;
+  std::vector<double> Key;
+  std::vector<vtkIdType> Predecessor;
+  std::vector<vtkIdType> PredecessorEdge;
+  std::vector<vtkIdType> HeapPosition;
+
+  // Binary min-heap of vertex ids keyed on Key, and the vertices whose
+  // search state must be reset before the next search.
+  std::vector<vtkIdType> Heap;
+  std::vector<vtkIdType> Touched;
+
+  // Cached route trees keyed on their root vertex, and their roots from the
+  // most to the least recently used.
+  std::map<vtkIdType, RouteTree> Routes;
+  std::list<vtkIdType> RouteUse;
+
+  // The tree index, valid if IsForest: each component is rooted at its
+  // lowest numbered vertex.
+  bool IsForest;
+  std::vector<vtkIdType> Depth;
+  std::vector<vtkIdType> TreeParent;
+  std::vector<vtkIdType> TreeParentEdge;
+
+  //---------------------------------------------------------------------------
+  vtkIdType GetNumberOfVertices() const
+  {
+    return this->Offsets.empty() ?
+        0 : static_cast<vtkIdType>(this->Offsets.size()) - 1;
+  }
+
+  //---------------------------------------------------------------------------
+  void ClearRoutes()
+  {
+    this->Routes.clear();
+    this->RouteUse.clear();
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Size the search arrays to match the snapshot.
+  void AllocateSearch()
+  {
+    vtkIdType numVertices = this->GetNumberOfVertices();
+    this->Distance.assign(numVertices, VTK_DOUBLE_MAX);
+    this->Key.assign(numVertices, VTK_DOUBLE_MAX);
+    this->Predecessor.assign(numVertices, -1);
+    this->PredecessorEdge.assign(numVertices, -1);
+    this->HeapPosition.assign(numVertices, Unvisited);
+    this->Heap.clear();
+    this->Touched.clear();
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Undo the previous search, visiting only the vertices it touched.
+  void ResetSearch()
+  {
+    for (size_t i = 0; i < this->Touched.size(); ++i)
+    {
+      vtkIdType v = this->Touched[i];
+      this->Distance[v] = VTK_DOUBLE_MAX;
+      this->Predecessor[v] = -1;
+      this->PredecessorEdge[v] = -1;
+      this->HeapPosition[v] = Unvisited;
+    }
+    this->Touched.clear();
+    this->Heap.clear();
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // The straight-line distance between two vertices.
+  double GetEuclideanDistance(vtkIdType u, vtkIdType v) const
+  {
+    double dx = this->Points[2 * u] - this->Points[2 * v];
+    double dy = this->Points[2 * u + 1] - this->Points[2 * v + 1];
+    return sqrt(dx * dx + dy * dy);
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Build the kd-tree by recursive median partitioning.
+  void BuildKdTree()
+  {
+    vtkIdType numPoints = static_cast<vtkIdType>(this->Points.size() / 2);
+    this->KdOrder.resize(numPoints);
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+      this->KdOrder[i] = i;
+    }
+    this->KdBounds[0] = this->KdBounds[2] = VTK_DOUBLE_MAX;
+    this->KdBounds[1] = this->KdBounds[3] = -VTK_DOUBLE_MAX;
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+      this->KdBounds[0] = std::min(this->KdBounds[0], this->Points[2 * i]);
+      this->KdBounds[1] = std::max(this->KdBounds[1], this->Points[2 * i]);
+      this->KdBounds[2] = std::min(this->KdBounds[2], this->Points[2 * i + 1]);
+      this->KdBounds[3] = std::max(this->KdBounds[3], this->Points[2 * i + 1]);
+    }
+    this->PartitionKdTree(0, numPoints, 0);
+  }
+
+  //---------------------------------------------------------------------------
+  void PartitionKdTree(vtkIdType lo, vtkIdType hi, int axis)
+  {
+    if (hi - lo < 2)
+    {
+      return;
+    }
+    vtkIdType mid = lo + (hi - lo) / 2;
+    std::nth_element(this->KdOrder.begin() + lo, this->KdOrder.begin() + mid,
+        this->KdOrder.begin() + hi,
+        vtkFlightMapRouterCompareCoordinate(&this->Points[0], axis));
+    this->PartitionKdTree(lo, mid, 1 - axis);
+    this->PartitionKdTree(mid + 1, hi, 1 - axis);
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Search the subtree [lo, hi), whose points lie in the box cell, for a
+  // point closer to x than bestDistance2 (squared) and accepted by the half
+  // plane (origin, normal); a null normal accepts everything.
+  void FindClosestInKdTree(vtkIdType lo, vtkIdType hi, int axis,
+      const double cell[4], const double x[2], const double* origin,
+      const double* normal, vtkIdType& best, double& bestDistance2) const
+  {
+    if (lo >= hi)
+    {
+      return;
+    }
+
+    // Prune the cell if it is farther than the best so far...
+    double dx = std::max(std::max(cell[0] - x[0], x[0] - cell[1]), 0.0);
+    double dy = std::max(std::max(cell[2] - x[1], x[1] - cell[3]), 0.0);
+    if (dx * dx + dy * dy >= bestDistance2)
+    {
+      return;
+    }
+
+    // ...or entirely outside the half plane (tested at its best corner).
+    if (normal)
+    {
+      double cx = normal[0] > 0.0 ? cell[1] : cell[0];
+      double cy = normal[1] > 0.0 ? cell[3] : cell[2];
+      if ((cx - origin[0]) * normal[0] + (cy - origin[1]) * normal[1] <= 0.0)
+      {
+        return;
+      }
+    }
+
+    vtkIdType mid = lo + (hi - lo) / 2;
+    vtkIdType v = this->KdOrder[mid];
+    const double* p = &this->Points[2 * v];
+    if (!normal
+        || (p[0] - origin[0]) * normal[0] + (p[1] - origin[1]) * normal[1]
+            > 0.0)
+    {
+      double d2 = (p[0] - x[0]) * (p[0] - x[0])
+          + (p[1] - x[1]) * (p[1] - x[1]);
+      if (d2 < bestDistance2)
+      {
+        bestDistance2 = d2;
+        best = v;
+      }
+    }
+
+    // Visit the side of the split containing x first.
+    double lowCell[4] =
+    { cell[0], cell[1], cell[2], cell[3] };
+    double highCell[4] =
+    { cell[0], cell[1], cell[2], cell[3] };
+    lowCell[2 * axis + 1] = p[axis];
+    highCell[2 * axis] = p[axis];
+    if (x[axis] < p[axis])
+    {
+      this->FindClosestInKdTree(lo, mid, 1 - axis, lowCell, x, origin, normal,
+          best, bestDistance2);
+      this->FindClosestInKdTree(mid + 1, hi, 1 - axis, highCell, x, origin,
+          normal, best, bestDistance2);
+    }
+    else
+    {
+      this->FindClosestInKdTree(mid + 1, hi, 1 - axis, highCell, x, origin,
+          normal, best, bestDistance2);
+      this->FindClosestInKdTree(lo, mid, 1 - axis, lowCell, x, origin, normal,
+          best, bestDistance2);
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  vtkIdType FindClosest(const double x[2], const double* origin,
+      const double* normal) const
+  {
+    vtkIdType best = -1;
+    double bestDistance2 = VTK_DOUBLE_MAX;
+    this->FindClosestInKdTree(0, static_cast<vtkIdType>(this->KdOrder.size()),
+        0, this->KdBounds, x, origin, normal, best, bestDistance2);
+    return best;
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Find the largest scale for which HeuristicScale * (straight-line
+  // distance) never overestimates the weight of an edge. Summed along any
+  // path this bounds the remaining distance from below, so the heuristic is
+  // admissible (and consistent). Negative weights rule out a heuristic.
+  void CalibrateHeuristic()
+  {
+    this->HeuristicScale = -1.0;
+    if (this->Points.empty())
+    {
+      return;
+    }
+
+    double scale = VTK_DOUBLE_MAX;
+    vtkIdType numVertices = this->GetNumberOfVertices();
+    for (vtkIdType u = 0; u < numVertices; ++u)
+    {
+      for (vtkIdType i = this->Offsets[u]; i < this->Offsets[u + 1]; ++i)
+      {
+        double weight = this->Weights[i];
+        if (weight < 0.0)
+        {
+          return;
+        }
+        double length = this->GetEuclideanDistance(u, this->Neighbours[i]);
+        if (length > 0.0 && weight / length < scale)
+        {
+          scale = weight / length;
+        }
+      }
+    }
+    this->HeuristicScale = scale;
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Root every component by breadth-first search, recording depths and
+  // parents. Gives up (IsForest false) on meeting any cycle, including
+  // parallel edges.
+  void BuildTreeIndex()
+  {
+    vtkIdType numVertices = this->GetNumberOfVertices();
+    this->IsForest = false;
+    this->Depth.assign(numVertices, -1);
+    this->TreeParent.assign(numVertices, -1);
+    this->TreeParentEdge.assign(numVertices, -1);
+
+    std::vector<vtkIdType> queue;
+    queue.reserve(numVertices);
+    for (vtkIdType root = 0; root < numVertices; ++root)
+    {
+      if (this->Depth[root] >= 0)
+      {
+        continue;
+      }
+      this->Depth[root] = 0;
+      queue.clear();
+      queue.push_back(root);
+      for (size_t head = 0; head < queue.size(); ++head)
+      {
+        vtkIdType u = queue[head];
+        for (vtkIdType i = this->Offsets[u]; i < this->Offsets[u + 1]; ++i)
+        {
+          if (this->EdgeIds[i] == this->TreeParentEdge[u])
+          {
+            continue;
+          }
+          vtkIdType v = this->Neighbours[i];
+          if (this->Depth[v] >= 0)
+          {
+            this->Depth.clear();
+            this->TreeParent.clear();
+            this->TreeParentEdge.clear();
+            return;
+          }
+          this->Depth[v] = this->Depth[u] + 1;
+          this->TreeParent[v] = u;
+          this->TreeParentEdge[v] = this->EdgeIds[i];
+          queue.push_back(v);
+        }
+      }
+    }
+    this->IsForest = true;
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Lower the distance to v, inserting it into the heap if necessary. The
+  // heap is ordered on distance plus the given heuristic estimate.
+  void DecreaseKey(vtkIdType v, double distance, double estimate)
+  {
+    if (this->HeapPosition[v] == Unvisited)
+    {
+      this->Touched.push_back(v);
+      this->HeapPosition[v] = static_cast<vtkIdType>(this->Heap.size());
+      this->Heap.push_back(v);
+    }
+    this->Distance[v] = distance;
+    this->Key[v] = distance + estimate;
+    this->SiftUp(this->HeapPosition[v]);
+  }
+
+  //---------------------------------------------------------------------------
+  // Description:
+  // Remove and return the vertex with the smallest distance, marking it as
+  // settled.
+  vtkIdType PopMin()
+  {
+    vtkIdType top = this->Heap[0];
+    vtkIdType last = this->Heap.back();
+    this->Heap.pop_back();
+    if (!this->Heap.empty())
+    {
+      this->Heap[0] = last;
+      this->HeapPosition[last] = 0;
+      this->SiftDown(0);
+    }
+    this->HeapPosition[top] = Settled;
+    return top;
+  }
+
+  //---------------------------------------------------------------------------
+  void SiftUp(vtkIdType i)
+  {
+    vtkIdType v = this->Heap[i];
+    double k = this->Key[v];
+    while (i > 0)
+    {
+      vtkIdType parent = (i - 1) / 2;
+      vtkIdType p = this->Heap[parent];
+      if (this->Key[p] <= k)
+      {
+        break;
+      }
+      this->Heap[i] = p;
+      this->HeapPosition[p] = i;
+      i = parent;
+    }
+    this->Heap[i] = v;
+    this->HeapPosition[v] = i;
+  }
+
+  //---------------------------------------------------------------------------
+  void SiftDown(vtkIdType i)
+  {
+    vtkIdType n = static_cast<vtkIdType>(this->Heap.size());
+    vtkIdType v = this->Heap[i];
+    double k = this->Key[v];
+    for (;;)
+    {
+      vtkIdType child = 2 * i + 1;
+      if (child >= n)
+      {
+        break;
+      }
+      if (child + 1 < n
+          && this->Key[this->Heap[child + 1]] < this->Key[this->Heap[child]])
+      {
+        ++child;
+      }
+      vtkIdType c = this->Heap[child];
+      if (k <= this->Key[c])
+      {
+        break;
+      }
+      this->Heap[i] = c;
+      this->HeapPosition[c] = i;
+      i = child;
+    }
+    this->Heap[i] = v;
+    this->HeapPosition[v] = i;
+  }
+};
+
+//-----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFlightMapRouter)
+vtkCxxSetObjectMacro(vtkFlightMapRouter, Graph, vtkGraph)
+
+//-----------------------------------------------------------------------------
+vtkFlightMapRouter::vtkFlightMapRouter()
+{
+  this->Graph = 0;
+  this->EdgeWeightArrayName = 0;
+  this->SetEdgeWeightArrayName("weights");
+  this->SearchStrategy = vtkFlightMapRouter::Dijkstra;
+  this->NumberOfSettledVertices = 0;
+  this->LastSearchUsedHeuristic = false;
+  this->TreeRouting = true;
+  this->LastPathWasTreeRouted = false;
+  this->CacheRoutes = false;
+  this->MaximumNumberOfCachedRoutes = 256;
+  this->MaximumRouteCacheSize = 65536;
+  this->LastPathWasCached = false;
+  this->AbortSearch = false;
+  this->Internals = new vtkFlightMapRouterInternals;
+  this->Internals->SnapshotGraph = 0;
+  this->Internals->Undirected = false;
+  this->Internals->IsForest = false;
+  this->Internals->HeuristicScale = -1.0;
+}
+
+//-----------------------------------------------------------------------------
+vtkFlightMapRouter::~vtkFlightMapRouter()
+{
+  this->SetGraph(0);
+  this->SetEdgeWeightArrayName(0);
+  delete this->Internals;
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapRouter::SetSearchStrategyToDijkstra()
+{
+  this->SetSearchStrategy(vtkFlightMapRouter::Dijkstra);
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapRouter::SetSearchStrategyToAStar()
+{
+  this->SetSearchStrategy(vtkFlightMapRouter::AStar);
+}
+
+//-----------------------------------------------------------------------------
+double vtkFlightMapRouter::GetHeuristicScale()
+{
+  return this->Internals->HeuristicScale;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkFlightMapRouter::GetGraphIsForest()
+{
+  return this->Internals->IsForest;
+}
+
+//-----------------------------------------------------------------------------
+int vtkFlightMapRouter::GetNumberOfCachedRoutes()
+{
+  return static_cast<int>(this->Internals->Routes.size());
+}
+
+//-----------------------------------------------------------------------------
+unsigned long vtkFlightMapRouter::GetRouteCacheSize()
+{
+  vtkFlightMapRouterInternals* internals = this->Internals;
+  unsigned long bytesPerTree = static_cast<unsigned long>(
+      2 * internals->GetNumberOfVertices() * sizeof(vtkIdType));
+  return (bytesPerTree * internals->Routes.size() + 1023) / 1024;
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapRouter::ClearRouteCache()
+{
+  this->Internals->ClearRoutes();
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapRouter::Update()
+{
+  if (!this->Graph)
+  {
+    vtkErrorMacro(<< "No graph has been set.");
+    return;
+  }
+
+  // Changing the search strategy or caching does not invalidate the snapshot
+  // (or the cached routes), so the modified time of this object is not used.
+  std::string weightArrayName =
+      this->EdgeWeightArrayName ? this->EdgeWeightArrayName : "";
+  if (this->Graph != this->Internals->SnapshotGraph
+      || weightArrayName != this->Internals->SnapshotWeightArrayName
+      || this->Graph->GetMTime() > this->BuildTime)
+  {
+    this->BuildSnapshot();
+    this->BuildTime.Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapRouter::BuildSnapshot()
+{
+  vtkFlightMapRouterInternals* internals = this->Internals;
+  vtkIdType numVertices = this->Graph->GetNumberOfVertices();
+  vtkIdType numEdges = this->Graph->GetNumberOfEdges();
+
+  internals->SnapshotGraph = this->Graph;
+  internals->SnapshotWeightArrayName =
+      this->EdgeWeightArrayName ? this->EdgeWeightArrayName : "";
+  internals->Undirected =
+      vtkUndirectedGraph::SafeDownCast(this->Graph) != 0;
+  internals->ClearRoutes();
+
+  vtkDataArray* weights = 0;
+  if (this->EdgeWeightArrayName)
+  {
+    weights = vtkDataArray::SafeDownCast(
+        this->Graph->GetEdgeData()->GetAbstractArray(
+            this->EdgeWeightArrayName));
+  }
+
+  // Each undirected edge appears once in the adjacency of both end points.
+  internals->Offsets.resize(numVertices + 1);
+  internals->Neighbours.clear();
+  internals->EdgeIds.clear();
+  internals->Weights.clear();
+  internals->Neighbours.reserve(2 * numEdges);
+  internals->EdgeIds.reserve(2 * numEdges);
+  internals->Weights.reserve(2 * numEdges);
+
+  vtkOutEdgeIterator* edges = vtkOutEdgeIterator::New();
+  for (vtkIdType v = 0; v < numVertices; ++v)
+  {
+    internals->Offsets[v] =
+        static_cast<vtkIdType>(internals->Neighbours.size());
+    this->Graph->GetOutEdges(v, edges);
+    while (edges->HasNext())
+    {
+      vtkOutEdgeType edge = edges->Next();
+      internals->Neighbours.push_back(edge.Target);
+      internals->EdgeIds.push_back(edge.Id);
+      internals->Weights.push_back(
+          weights ? weights->GetTuple1(edge.Id) : 1.0);
+    }
+  }
+  internals->Offsets[numVertices] =
+      static_cast<vtkIdType>(internals->Neighbours.size());
+  edges->Delete();
+
+  // Copy the layout into a flat 2D array for the A* heuristic.
+  internals->Points.clear();
+  vtkPoints* points = this->Graph->GetPoints();
+  if (points && points->GetNumberOfPoints() == numVertices)
+  {
+    internals->Points.resize(2 * numVertices);
+    double p[3];
+    for (vtkIdType v = 0; v < numVertices; ++v)
+    {
+      points->GetPoint(v, p);
+      internals->Points[2 * v] = p[0];
+      internals->Points[2 * v + 1] = p[1];
+    }
+  }
+  internals->CalibrateHeuristic();
+  internals->BuildKdTree();
+
+  if (internals->Undirected)
+  {
+    internals->BuildTreeIndex();
+  }
+  else
+  {
+    internals->IsForest = false;
+  }
+
+  internals->AllocateSearch();
+}
+
+//-----------------------------------------------------------------------------
+bool vtkFlightMapRouter::Search(vtkIdType startVertexId,
+    vtkIdType endVertexId, bool useHeuristic)
+{
+  vtkFlightMapRouterInternals* internals = this->Internals;
+  internals->ResetSearch();
+  this->NumberOfSettledVertices = 0;
+  double scale = useHeuristic ? internals->HeuristicScale : 0.0;
+  double numVertices =
+      static_cast<double>(internals->GetNumberOfVertices());
+
+  internals->DecreaseKey(startVertexId, 0.0, 0.0);
+  while (!internals->Heap.empty())
+  {
+    vtkIdType u = internals->PopMin();
+    ++this->NumberOfSettledVertices;
+    if (u == endVertexId)
+    {
+      return true; // found the target
+    }
+
+    if (this->NumberOfSettledVertices
+        % VTK_FLIGHT_MAP_ROUTER_PROGRESS_INTERVAL == 0)
+    {
+      double progress = this->NumberOfSettledVertices / numVertices;
+      this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+      if (this->AbortSearch)
+      {
+        return false;
+      }
+    }
+
+    double distanceToU = internals->Distance[u];
+    vtkIdType end = internals->Offsets[u + 1];
+    for (vtkIdType i = internals->Offsets[u]; i < end; ++i)
+    {
+      vtkIdType v = internals->Neighbours[i];
+      if (internals->HeapPosition[v]
+          == vtkFlightMapRouterInternals::Settled)
+      {
+        continue;
+      }
+
+      double distanceToV = distanceToU + internals->Weights[i];
+      if (distanceToV < internals->Distance[v])
+      {
+        internals->Predecessor[v] = u;
+        internals->PredecessorEdge[v] = internals->EdgeIds[i];
+        internals->DecreaseKey(v, distanceToV,
+            scale == 0.0 ?
+                0.0 :
+                scale * internals->GetEuclideanDistance(v, endVertexId));
+      }
+    }
+  }
+
+  // There is no path
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType vtkFlightMapRouter::FindClosestVertex(const double x[2])
+{
+  this->Update();
+  return this->Internals->FindClosest(x, 0, 0);
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType vtkFlightMapRouter::FindClosestVertexInHalfPlane(const double x[2],
+    const double origin[2], const double normal[2])
+{
+  this->Update();
+  if (normal[0] == 0.0 && normal[1] == 0.0)
+  {
+    return this->Internals->FindClosest(x, 0, 0);
+  }
+  return this->Internals->FindClosest(x, origin, normal);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkFlightMapRouter::FindPath(vtkIdType startVertexId,
+    vtkIdType endVertexId, vtkIdList* vertexPath, vtkIdList* edgePath)
+{
+  vertexPath->Reset();
+  if (edgePath)
+  {
+    edgePath->Reset();
+  }
+  this->LastPathWasCached = false;
+  this->LastPathWasTreeRouted = false;
+  this->AbortSearch = false;
+
+  this->Update();
+  vtkIdType numVertices = this->Internals->GetNumberOfVertices();
+  if (startVertexId < 0 || startVertexId >= numVertices || endVertexId < 0
+      || endVertexId >= numVertices)
+  {
+    vtkErrorMacro(<< "Vertex id out of range.");
+    return false;
+  }
+
+  if (this->TreeRouting && this->Internals->IsForest)
+  {
+    this->LastSearchUsedHeuristic = false;
+    return this->FindTreePath(startVertexId, endVertexId, vertexPath,
+        edgePath);
+  }
+
+  // The tree rooted at the destination only gives paths *to* it if every
+  // edge can be travelled in both directions.
+  if (this->CacheRoutes && this->Internals->Undirected)
+  {
+    this->LastSearchUsedHeuristic = false;
+    return this->FindCachedPath(startVertexId, endVertexId, vertexPath,
+        edgePath);
+  }
+
+  // A* needs an admissible heuristic, otherwise fall back to Dijkstra.
+  this->LastSearchUsedHeuristic =
+      this->SearchStrategy == vtkFlightMapRouter::AStar
+      && this->Internals->HeuristicScale > 0.0;
+
+  if (!this->Search(startVertexId, endVertexId,
+      this->LastSearchUsedHeuristic))
+  {
+    return false;
+  }
+
+  // Count the path length, then fill the lists back to front.
+  vtkIdType numIds = 1;
+  for (vtkIdType u = endVertexId; u != startVertexId;
+      u = this->Internals->Predecessor[u])
+  {
+    ++numIds;
+  }
+
+  vertexPath->SetNumberOfIds(numIds);
+  if (edgePath)
+  {
+    edgePath->SetNumberOfIds(numIds - 1);
+  }
+  vtkIdType u = endVertexId;
+  for (vtkIdType i = numIds - 1; i > 0; --i)
+  {
+    vertexPath->SetId(i, u);
+    if (edgePath)
+    {
+      edgePath->SetId(i - 1, this->Internals->PredecessorEdge[u]);
+    }
+    u = this->Internals->Predecessor[u];
+  }
+  vertexPath->SetId(0, startVertexId);
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkFlightMapRouter::FindCachedPath(vtkIdType startVertexId,
+    vtkIdType endVertexId, vtkIdList* vertexPath, vtkIdList* edgePath)
+{
+  vtkFlightMapRouterInternals* internals = this->Internals;
+  std::map<vtkIdType, vtkFlightMapRouterInternals::RouteTree>::iterator tree =
+      internals->Routes.find(endVertexId);
+  if (tree == internals->Routes.end())
+  {
+    // Grow the complete tree from the destination: no vertex is the target,
+    // so the search only stops once everything reachable is settled (or it
+    // is aborted, when nothing is cached or evicted).
+    this->Search(endVertexId, -1, false);
+    if (this->AbortSearch)
+    {
+      return false;
+    }
+
+    // Make room within both limits by evicting the least recently used
+    // trees, keeping the arrays of the last one evicted for the new tree.
+    vtkIdType numVertices = internals->GetNumberOfVertices();
+    double bytesPerTree =
+        2.0 * sizeof(vtkIdType) * std::max<vtkIdType>(numVertices, 1);
+    double maximumByBudget =
+        1024.0 * this->MaximumRouteCacheSize / bytesPerTree;
+    size_t maximumRoutes = static_cast<size_t>(std::max(1.0,
+        std::min<double>(maximumByBudget, this->MaximumNumberOfCachedRoutes)));
+    vtkFlightMapRouterInternals::RouteTree recycled;
+    while (internals->Routes.size() >= maximumRoutes)
+    {
+      std::map<vtkIdType, vtkFlightMapRouterInternals::RouteTree>::iterator
+          oldest = internals->Routes.find(internals->RouteUse.back());
+      recycled.Parent.swap(oldest->second.Parent);
+      recycled.ParentEdge.swap(oldest->second.ParentEdge);
+      internals->Routes.erase(oldest);
+      internals->RouteUse.pop_back();
+    }
+
+    tree = internals->Routes.insert(std::make_pair(endVertexId,
+        vtkFlightMapRouterInternals::RouteTree())).first;
+    tree->second.Parent.swap(recycled.Parent);
+    tree->second.ParentEdge.swap(recycled.ParentEdge);
+    tree->second.Parent.assign(internals->Predecessor.begin(),
+        internals->Predecessor.end());
+    tree->second.ParentEdge.assign(internals->PredecessorEdge.begin(),
+        internals->PredecessorEdge.end());
+    internals->RouteUse.push_front(endVertexId);
+    tree->second.Use = internals->RouteUse.begin();
+  }
+  else
+  {
+    internals->RouteUse.splice(internals->RouteUse.begin(),
+        internals->RouteUse, tree->second.Use);
+    this->NumberOfSettledVertices = 0;
+    this->LastPathWasCached = true;
+  }
+
+  const std::vector<vtkIdType>& parent = tree->second.Parent;
+  const std::vector<vtkIdType>& parentEdge = tree->second.ParentEdge;
+  if (startVertexId != endVertexId && parent[startVertexId] < 0)
+  {
+    return false; // There is no path
+  }
+
+  // The parent pointers lead from the start towards the destination, so the
+  // lists are filled front to back.
+  vtkIdType numIds = 1;
+  for (vtkIdType u = startVertexId; u != endVertexId; u = parent[u])
+  {
+    ++numIds;
+  }
+
+  vertexPath->SetNumberOfIds(numIds);
+  if (edgePath)
+  {
+    edgePath->SetNumberOfIds(numIds - 1);
+  }
+  vtkIdType u = startVertexId;
+  for (vtkIdType i = 0; i < numIds - 1; ++i)
+  {
+    vertexPath->SetId(i, u);
+    if (edgePath)
+    {
+      edgePath->SetId(i, parentEdge[u]);
+    }
+    u = parent[u];
+  }
+  vertexPath->SetId(numIds - 1, endVertexId);
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkFlightMapRouter::FindTreePath(vtkIdType startVertexId,
+    vtkIdType endVertexId, vtkIdList* vertexPath, vtkIdList* edgePath)
+{
+  const std::vector<vtkIdType>& depth = this->Internals->Depth;
+  const std::vector<vtkIdType>& parent = this->Internals->TreeParent;
+  const std::vector<vtkIdType>& parentEdge = this->Internals->TreeParentEdge;
+  this->NumberOfSettledVertices = 0;
+
+  // Climb from the deeper end point to the depth of the other, then from both
+  // in step until they meet. Each step is a vertex of the path, so this costs
+  // no more than writing the path out.
+  vtkIdType u = startVertexId;
+  vtkIdType v = endVertexId;
+  while (depth[u] > depth[v])
+  {
+    u = parent[u];
+  }
+  while (depth[v] > depth[u])
+  {
+    v = parent[v];
+  }
+  while (u != v)
+  {
+    u = parent[u];
+    v = parent[v];
+    if (u < 0)
+    {
+      return false; // Different components, there is no path
+    }
+  }
+  vtkIdType ancestor = u;
+
+  vtkIdType numUp = depth[startVertexId] - depth[ancestor];
+  vtkIdType numIds = numUp + depth[endVertexId] - depth[ancestor] + 1;
+  vertexPath->SetNumberOfIds(numIds);
+  if (edgePath)
+  {
+    edgePath->SetNumberOfIds(numIds - 1);
+  }
+
+  // Up from the start to the ancestor...
+  u = startVertexId;
+  for (vtkIdType i = 0; i < numUp; ++i)
+  {
+    vertexPath->SetId(i, u);
+    if (edgePath)
+    {
+      edgePath->SetId(i, parentEdge[u]);
+    }
+    u = parent[u];
+  }
+  vertexPath->SetId(numUp, ancestor);
+
+  // ...then down to the end, filled back to front.
+  v = endVertexId;
+  for (vtkIdType i = numIds - 1; i > numUp; --i)
+  {
+    vertexPath->SetId(i, v);
+    if (edgePath)
+    {
+      edgePath->SetId(i - 1, parentEdge[v]);
+    }
+    v = parent[v];
+  }
+
+  this->LastPathWasTreeRouted = true;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkFlightMapRouter::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Graph: " << this->Graph << endl;
+  os << indent << "EdgeWeightArrayName: "
+      << (this->EdgeWeightArrayName ? this->EdgeWeightArrayName : "(none)")
+      << endl;
+  os << indent << "SearchStrategy: "
+      << (this->SearchStrategy == vtkFlightMapRouter::AStar ?
+          "AStar" : "Dijkstra") << endl;
+  os << indent << "HeuristicScale: " << this->Internals->HeuristicScale
+      << endl;
+  os << indent << "NumberOfSettledVertices: " << this->NumberOfSettledVertices
+      << endl;
+  os << indent << "LastSearchUsedHeuristic: "
+      << (this->LastSearchUsedHeuristic ? "On" : "Off") << endl;
+  os << indent << "TreeRouting: " << (this->TreeRouting ? "On" : "Off")
+      << endl;
+  os << indent << "GraphIsForest: "
+      << (this->Internals->IsForest ? "Yes" : "No") << endl;
+  os << indent << "LastPathWasTreeRouted: "
+      << (this->LastPathWasTreeRouted ? "On" : "Off") << endl;
+  os << indent << "CacheRoutes: " << (this->CacheRoutes ? "On" : "Off")
+      << endl;
+  os << indent << "MaximumNumberOfCachedRoutes: "
+      << this->MaximumNumberOfCachedRoutes << endl;
+  os << indent << "MaximumRouteCacheSize: " << this->MaximumRouteCacheSize
+      << endl;
+  os << indent << "NumberOfCachedRoutes: "
+      << this->Internals->Routes.size() << endl;
+  os << indent << "RouteCacheSize: " << this->GetRouteCacheSize() << endl;
+  os << indent << "LastPathWasCached: "
+      << (this->LastPathWasCached ? "On" : "Off") << endl;
+  os << indent << "AbortSearch: " << (this->AbortSearch ? "On" : "Off")
+      << endl;
+}
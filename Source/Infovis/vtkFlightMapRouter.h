@@ -0,0 +1,251 @@
+/*=========================================================================
+
+ Program:   Visualization Toolkit
+ Module:    vtkFlightMapRouter.h
+
+ Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+ All rights reserved.
+ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+ =========================================================================*/
+// .NAME vtkFlightMapRouter - Shortest-path queries over a flight map.
+//
+// .SECTION Description
+// vtkFlightMapRouter answers single-pair shortest-path queries over a weighted
+// graph, usually the output of vtkFlightMapFilter. On first use (and whenever
+// the graph is modified) the graph is flattened into a compressed sparse row
+// (CSR) snapshot: one offset per vertex into contiguous arrays of neighbours,
+// edge ids and edge weights.
+//
+// Queries run Dijkstra's algorithm on the snapshot using contiguous distance
+// and predecessor arrays and an indexed binary heap with decrease-key. The
+// search stops as soon as the target vertex is settled, and only the vertices
+// touched by a query are reset before the next one, so the cost of a query
+// depends on the part of the graph explored rather than the size of the graph.
+//
+// With SetSearchStrategyToAStar() the search is guided by the straight-line
+// distance from each vertex to the target, scaled by the smallest ratio of
+// edge weight to edge length found in the graph. This keeps the heuristic
+// admissible for whatever weights vtkFlightMapFilter produced. If some weight
+// is negative, or the scale is zero, no useful admissible heuristic exists and
+// the router falls back to plain Dijkstra.
+//
+// Flights usually end at one of a small number of landmark vertices. With
+// CacheRoutesOn() the first query towards a destination computes the complete
+// shortest-path tree rooted at that destination, and every later query to the
+// same destination is answered by walking parent pointers from the start
+// vertex, whatever the start. The trees are discarded when the graph is
+// modified. Route caching needs an undirected graph and is ignored otherwise.
+// Each tree holds a parent and a parent edge id for every vertex of the
+// graph, 16 bytes per vertex with 64 bit ids, so 256 trees over a graph of a
+// quarter of a million vertices would take 1 GB. The cache is therefore
+// bounded by MaximumRouteCacheSize as well as by the number of trees, and the
+// least recently used tree is evicted to make room for a new one.
+//
+// vtkFlightMapFilter produces a spanning tree, in which the path between two
+// vertices is unique. When the snapshot of an undirected graph turns out to
+// be a forest the router also records the depth and parent of every vertex
+// in a rooted tree of each component. With TreeRouting on (the default) a
+// query then climbs from both end points to their lowest common ancestor,
+// costing O(path length) regardless of the size of the graph, and no search
+// or cache is needed.
+//
+// The snapshot also holds a 2D kd-tree over the vertex positions (x and y of
+// the graph points), stored implicitly as a permutation of the vertex ids.
+// FindClosestVertex() and FindClosestVertexInHalfPlane() use it to locate
+// the start and end of a route without any allocation.
+//
+// A search invokes vtkCommand::ProgressEvent, with the fraction of the
+// vertices settled so far as call data, every few thousand settled vertices.
+// An observer may then set AbortSearch to stop a query that is no longer
+// wanted, e.g. one superseded while it ran on another thread.
+//
+// .SEE ALSO
+// vtkFlightMapFilter vtkOffScreenWidget
+
+#ifndef __vtkFlightMapRouter_h
+#define __vtkFlightMapRouter_h
+
+#include "vtkcsmInfovisWin32Header.h"
+#include "vtkObject.h"
+
+// Private class holding the CSR snapshot and search state.
+class vtkFlightMapRouterInternals;
+
+class vtkGraph;
+class vtkIdList;
+
+
+class VTK_CSM_INFOVIS_EXPORT vtkFlightMapRouter: public vtkObject
+{
+public:
+  static vtkFlightMapRouter *New();
+  vtkTypeMacro(vtkFlightMapRouter, vtkObject)
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Description:
+  // Set/Get the graph to route over.
+  void SetGraph(vtkGraph* graph);
+  vtkGetObjectMacro(Graph, vtkGraph)
+
+  // Description:
+  // Set/Get the name of the edge data array holding the edge weights. If the
+  // array is not found every edge has unit weight. Default "weights".
+  vtkSetStringMacro(EdgeWeightArrayName)
+  vtkGetStringMacro(EdgeWeightArrayName)
+
+  // Description:
+  // Set/Get the search strategy. Default is Dijkstra.
+  enum
+  {
+    Dijkstra = 0, AStar
+  };
+  vtkSetClampMacro(SearchStrategy, int, Dijkstra, AStar)
+  vtkGetMacro(SearchStrategy, int)
+  void SetSearchStrategyToDijkstra();
+  void SetSearchStrategyToAStar();
+
+  // Description:
+  // The factor applied to straight-line distances to form the A* heuristic,
+  // calibrated against the edge weights of the current snapshot. Negative if
+  // the weights do not admit a heuristic.
+  double GetHeuristicScale();
+
+  // Description:
+  // Route through the tree index when the graph is a forest. Default on.
+  vtkSetMacro(TreeRouting, bool)
+  vtkGetMacro(TreeRouting, bool)
+  vtkBooleanMacro(TreeRouting, bool)
+
+  // Description:
+  // Whether the current snapshot is an undirected forest, i.e. whether tree
+  // routing is possible.
+  bool GetGraphIsForest();
+
+  // Description:
+  // Cache a shortest-path tree per destination vertex. Default off.
+  vtkSetMacro(CacheRoutes, bool)
+  vtkGetMacro(CacheRoutes, bool)
+  vtkBooleanMacro(CacheRoutes, bool)
+
+  // Description:
+  // The maximum number of destination trees to keep. When a new tree would
+  // exceed this the least recently used trees are evicted first. Default 256.
+  vtkSetClampMacro(MaximumNumberOfCachedRoutes, int, 1, VTK_INT_MAX)
+  vtkGetMacro(MaximumNumberOfCachedRoutes, int)
+
+  // Description:
+  // The maximum memory, in kibibytes, the destination trees may take. A tree
+  // costs 2 * sizeof(vtkIdType) bytes per vertex, so on large graphs this
+  // limits the cache to fewer trees than MaximumNumberOfCachedRoutes. At
+  // least one tree is always kept. Default 65536 (64 MiB).
+  vtkSetMacro(MaximumRouteCacheSize, unsigned long)
+  vtkGetMacro(MaximumRouteCacheSize, unsigned long)
+
+  // Description:
+  // The number of destination trees currently cached, and the memory they
+  // take in kibibytes.
+  int GetNumberOfCachedRoutes();
+  unsigned long GetRouteCacheSize();
+
+  // Description:
+  // Discard the cached destination trees.
+  void ClearRouteCache();
+
+  // Description:
+  // Rebuild the CSR snapshot if the graph has been modified (or replaced, or
+  // the weight array renamed) since the last build. Called automatically by
+  // FindPath().
+  void Update();
+
+  // Description:
+  // Return the id of the vertex closest to x (only x[0] and x[1] are used),
+  // or -1 if the graph has no points.
+  vtkIdType FindClosestVertex(const double x[2]);
+
+  // Description:
+  // Return the id of the vertex closest to x among those strictly on the
+  // positive side of the line through origin with the given normal, i.e.
+  // with (p - origin) . normal > 0. A zero normal accepts every vertex.
+  // Returns -1 if no vertex qualifies.
+  vtkIdType FindClosestVertexInHalfPlane(const double x[2],
+      const double origin[2], const double normal[2]);
+
+  // Description:
+  // Find the shortest path between two vertices. The vertex ids along the
+  // path, including both end points, are returned in vertexPath. If edgePath
+  // is not NULL it receives the ids of the edges along the path. Returns false
+  // (with empty lists) if there is no path.
+  bool FindPath(vtkIdType startVertexId, vtkIdType endVertexId,
+      vtkIdList* vertexPath, vtkIdList* edgePath = 0);
+
+  // Description:
+  // The number of vertices settled by the last call to FindPath(), whether
+  // that search used the A* heuristic, and whether it was answered from the
+  // route cache or the tree index (in which case no vertices are settled).
+  vtkGetMacro(NumberOfSettledVertices, vtkIdType)
+  vtkGetMacro(LastSearchUsedHeuristic, bool)
+  vtkGetMacro(LastPathWasCached, bool)
+  vtkGetMacro(LastPathWasTreeRouted, bool)
+
+  // Description:
+  // Set to stop the search in progress, usually from an observer of the
+  // ProgressEvent. FindPath() then returns false, and no route is cached.
+  // Cleared at the start of every FindPath().
+  vtkSetMacro(AbortSearch, bool)
+  vtkGetMacro(AbortSearch, bool)
+  vtkBooleanMacro(AbortSearch, bool)
+
+protected:
+  vtkFlightMapRouter();
+  ~vtkFlightMapRouter();
+
+  // Description:
+  // Flatten the graph into the CSR arrays.
+  void BuildSnapshot();
+
+  // Description:
+  // Run Dijkstra's SSSP (or A* if useHeuristic is set) from start, stopping
+  // once end is settled. Returns false if end is unreachable or the search
+  // was aborted.
+  bool Search(vtkIdType startVertexId, vtkIdType endVertexId,
+      bool useHeuristic);
+
+  // Description:
+  // Find the path by walking the cached tree rooted at endVertexId, building
+  // the tree first if necessary.
+  bool FindCachedPath(vtkIdType startVertexId, vtkIdType endVertexId,
+      vtkIdList* vertexPath, vtkIdList* edgePath);
+
+  // Description:
+  // Find the unique path between two vertices of a forest by climbing to
+  // their lowest common ancestor.
+  bool FindTreePath(vtkIdType startVertexId, vtkIdType endVertexId,
+      vtkIdList* vertexPath, vtkIdList* edgePath);
+
+  vtkGraph* Graph;
+  char* EdgeWeightArrayName;
+  int SearchStrategy;
+  vtkIdType NumberOfSettledVertices;
+  bool LastSearchUsedHeuristic;
+  bool TreeRouting;
+  bool LastPathWasTreeRouted;
+  bool CacheRoutes;
+  int MaximumNumberOfCachedRoutes;
+  unsigned long MaximumRouteCacheSize;
+  bool LastPathWasCached;
+  bool AbortSearch;
+
+  vtkTimeStamp BuildTime;
+  vtkFlightMapRouterInternals* Internals;
+
+private:
+  vtkFlightMapRouter(const vtkFlightMapRouter&); // Not implemented
+  void operator=(const vtkFlightMapRouter&); // Not implemented
+};
+
+#endif // __vtkFlightMapRouter_h
@@ -31,6 +31,7 @@
 #include "vtkGraphToPolyData.h"
 #include "vtkIdTypeArray.h"
 #include "vtkInformation.h"
+#include "vtkMath.h"
 #include "vtkObjectFactory.h"
 #include "vtkPoints.h"
 #include "vtkPointSetToLabelHierarchy.h"
@@ -44,13 +45,271 @@
 #include "vtkStringArray.h"
 #include "vtkTable.h"
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 
 vtkStandardNewMacro(vtkAnnotatedGraphRepresentation)
 
+//----------------------------------------------------------------------------
+// Description:
+// A uniform grid over the layout vertex positions for lasso selection. The
+// grid is rebuilt only when the layout changes. A lasso is rasterised onto
+// the cells under its bounding box: cells within a cell of a lasso edge are
+// boundary cells, and the others lie wholly inside or outside the lasso, as
+// a crossing-number test at their centre tells. Only the vertices of
+// boundary cells need the exact test.
+class vtkAnnotatedGraphRepresentationVertexGrid
+{
+public:
+  vtkAnnotatedGraphRepresentationVertexGrid() :
+      Points(0), Planar(false)
+  {
+    this->Origin[0] = this->Origin[1] = 0.0;
+    this->CellSize[0] = this->CellSize[1] = 1.0;
+    this->Dimensions[0] = this->Dimensions[1] = 0;
+    this->Normal[0] = this->Normal[1] = this->Normal[2] = 0.0;
+  }
+
+  //--------------------------------------------------------------------------
+  // Description:
+  // Bin the vertices of the graph, unless the layout has not changed since
+  // the last time.
+  void Update(vtkGraph* graph)
+  {
+    vtkPoints* points = graph->GetPoints();
+    if (points == this->Points && graph->GetMTime() <= this->BuildTime
+        && points->GetMTime() <= this->BuildTime)
+    {
+      return;
+    }
+    this->Points = points;
+    this->BuildTime.Modified();
+
+    // The exact test fires its rays in the plane of this normal, which for a
+    // 2D layout is the z axis
+    vtkPolygon::ComputeNormal(points, this->Normal);
+    this->Planar = this->Normal[0] == 0.0 && this->Normal[1] == 0.0
+        && this->Normal[2] != 0.0;
+
+    // About one vertex to a cell
+    vtkIdType numPoints = points->GetNumberOfPoints();
+    double bounds[6];
+    points->GetBounds(bounds);
+    int resolution = std::max(1, static_cast<int>(sqrt(
+        static_cast<double>(numPoints))));
+    for (int i = 0; i < 2; ++i)
+    {
+      double range = bounds[2 * i + 1] - bounds[2 * i];
+      this->Origin[i] = bounds[2 * i];
+      this->Dimensions[i] = range > 0.0 ? resolution : 1;
+      this->CellSize[i] = range > 0.0 ? range / resolution : 1.0;
+    }
+
+    // Counting sort of the vertex ids by cell, keeping them in order
+    int numCells = this->Dimensions[0] * this->Dimensions[1];
+    std::vector<int> cellOfPoint(numPoints);
+    this->CellStart.assign(numCells + 1, 0);
+    double x[3];
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+      points->GetPoint(i, x);
+      cellOfPoint[i] = this->GetCell(this->GetColumn(x[0]), this->GetRow(x[1]));
+      ++this->CellStart[cellOfPoint[i] + 1];
+    }
+    for (int c = 0; c < numCells; ++c)
+    {
+      this->CellStart[c + 1] += this->CellStart[c];
+    }
+    this->CellPoints.resize(numPoints);
+    std::vector<vtkIdType> next(this->CellStart.begin(),
+        this->CellStart.end() - 1);
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+      this->CellPoints[next[cellOfPoint[i]]++] = i;
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  const double* GetNormal() const
+  {
+    return this->Normal;
+  }
+
+  //--------------------------------------------------------------------------
+  // Description:
+  // Sort the vertices under the lasso into those certainly inside it and
+  // those that need the exact test. Returns false if the grid cannot
+  // classify them, when every vertex needs the exact test.
+  bool Classify(const double* lasso, int numLassoPoints,
+      const double lassoBounds[6], std::vector<vtkIdType>& inside,
+      std::vector<vtkIdType>& candidates) const
+  {
+    if (!this->Planar || lassoBounds[4] > 0.0 || lassoBounds[5] < 0.0)
+    {
+      return false;
+    }
+    if (lassoBounds[1] < this->Origin[0] || lassoBounds[3] < this->Origin[1]
+        || lassoBounds[0] > this->Origin[0]
+            + this->Dimensions[0] * this->CellSize[0]
+        || lassoBounds[2] > this->Origin[1]
+            + this->Dimensions[1] * this->CellSize[1])
+    {
+      // Nothing under the lasso
+      return true;
+    }
+
+    // Cells under the bounding box of the lasso
+    int c0 = this->GetColumn(lassoBounds[0]);
+    int c1 = this->GetColumn(lassoBounds[1]);
+    int r0 = this->GetRow(lassoBounds[2]);
+    int r1 = this->GetRow(lassoBounds[3]);
+    int width = c1 - c0 + 1;
+    int height = r1 - r0 + 1;
+    enum
+    {
+      Outside = 0, Boundary, Inside
+    };
+    std::vector<char> state(width * height, Outside);
+
+    // Mark the cells within a cell of each edge, column by column
+    double cw = this->CellSize[0];
+    double ch = this->CellSize[1];
+    for (int k = 0; k < numLassoPoints; ++k)
+    {
+      const double* a = lasso + 3 * k;
+      const double* b = lasso + 3 * ((k + 1) % numLassoPoints);
+      int ca = std::max(c0, this->GetColumn(std::min(a[0], b[0]) - cw));
+      int cb = std::min(c1, this->GetColumn(std::max(a[0], b[0]) + cw));
+      for (int c = ca; c <= cb; ++c)
+      {
+        double x0 = this->Origin[0] + (c - 1) * cw;
+        double x1 = this->Origin[0] + (c + 2) * cw;
+        double ya, yb;
+        if (a[0] == b[0])
+        {
+          ya = a[1];
+          yb = b[1];
+        }
+        else
+        {
+          double ta = (std::max(std::min(a[0], b[0]), x0) - a[0])
+              / (b[0] - a[0]);
+          double tb = (std::min(std::max(a[0], b[0]), x1) - a[0])
+              / (b[0] - a[0]);
+          ya = a[1] + ta * (b[1] - a[1]);
+          yb = a[1] + tb * (b[1] - a[1]);
+        }
+        int ra = std::max(r0, this->GetRow(std::min(ya, yb) - ch));
+        int rb = std::min(r1, this->GetRow(std::max(ya, yb) + ch));
+        for (int r = ra; r <= rb; ++r)
+        {
+          state[(r - r0) * width + (c - c0)] = Boundary;
+        }
+      }
+    }
+
+    // Classify the other cells row by row by the lasso crossings left of
+    // their centres
+    std::vector<double> crossings;
+    for (int r = r0; r <= r1; ++r)
+    {
+      double y = this->Origin[1] + (r + 0.5) * ch;
+      crossings.clear();
+      for (int k = 0; k < numLassoPoints; ++k)
+      {
+        const double* a = lasso + 3 * k;
+        const double* b = lasso + 3 * ((k + 1) % numLassoPoints);
+        if ((a[1] <= y) != (b[1] <= y))
+        {
+          crossings.push_back(
+              a[0] + (y - a[1]) * (b[0] - a[0]) / (b[1] - a[1]));
+        }
+      }
+      std::sort(crossings.begin(), crossings.end());
+      size_t numLeft = 0;
+      for (int c = c0; c <= c1; ++c)
+      {
+        double x = this->Origin[0] + (c + 0.5) * cw;
+        while (numLeft < crossings.size() && crossings[numLeft] < x)
+        {
+          ++numLeft;
+        }
+        char& cellState = state[(r - r0) * width + (c - c0)];
+        if (cellState == Outside && numLeft % 2 == 1)
+        {
+          cellState = Inside;
+        }
+      }
+    }
+
+    for (int r = r0; r <= r1; ++r)
+    {
+      for (int c = c0; c <= c1; ++c)
+      {
+        char cellState = state[(r - r0) * width + (c - c0)];
+        if (cellState == Outside)
+        {
+          continue;
+        }
+        int cell = this->GetCell(c, r);
+        std::vector<vtkIdType>& ids =
+            cellState == Inside ? inside : candidates;
+        ids.insert(ids.end(), this->CellPoints.begin() + this->CellStart[cell],
+            this->CellPoints.begin() + this->CellStart[cell + 1]);
+      }
+    }
+    return true;
+  }
+
+private:
+  //--------------------------------------------------------------------------
+  int GetColumn(double x) const
+  {
+    return this->Clamp((x - this->Origin[0]) / this->CellSize[0],
+        this->Dimensions[0]);
+  }
+
+  //--------------------------------------------------------------------------
+  int GetRow(double y) const
+  {
+    return this->Clamp((y - this->Origin[1]) / this->CellSize[1],
+        this->Dimensions[1]);
+  }
+
+  //--------------------------------------------------------------------------
+  int GetCell(int column, int row) const
+  {
+    return row * this->Dimensions[0] + column;
+  }
+
+  //--------------------------------------------------------------------------
+  static int Clamp(double index, int dimension)
+  {
+    if (!(index > 0.0))
+    {
+      return 0;
+    }
+    return index < dimension ? static_cast<int>(index) : dimension - 1;
+  }
+
+  vtkPoints* Points;
+  vtkTimeStamp BuildTime;
+  bool Planar;
+  double Normal[3];
+  double Origin[2];
+  double CellSize[2];
+  int Dimensions[2];
+  std::vector<vtkIdType> CellStart;
+  std::vector<vtkIdType> CellPoints;
+};
+
 //----------------------------------------------------------------------------
 vtkAnnotatedGraphRepresentation::vtkAnnotatedGraphRepresentation()
 {
   this->LastSelectionNode = 0;
+  this->VertexGrid = new vtkAnnotatedGraphRepresentationVertexGrid;
 
   this->LandmarkGlyph = vtkSmartPointer<vtkGraphAnnotationLayersFilter>::New();
   this->LandmarkMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
@@ -108,7 +367,7 @@ vtkAnnotatedGraphRepresentation::vtkAnnotatedGraphRepresentation()
 //----------------------------------------------------------------------------
 vtkAnnotatedGraphRepresentation::~vtkAnnotatedGraphRepresentation()
 {
-  //
+  delete this->VertexGrid;
 }
 
 //----------------------------------------------------------------------------
@@ -412,18 +671,43 @@ void vtkAnnotatedGraphRepresentation::LassoSelect(vtkPoints* lassoPoints,
     return;
   }
 
+  // The exact test fails for a lasso without area or a layout without a
+  // plane, but vertices the grid classifies are never tested, so check here
+  this->VertexGrid->Update(graph);
+  double lassoNormal[3];
+  vtkPolygon::ComputeNormal(lassoPoints, lassoNormal);
+  if (numSelectionPoints < 3 || vtkMath::Norm(lassoNormal) == 0.0
+      || vtkMath::Norm(this->VertexGrid->GetNormal()) == 0.0)
+  {
+    vtkWarningMacro(<< "Lasso select: Degenerate polygon");
+    return;
+  }
+
+  // Only the vertices near the edge of the lasso need the exact test
+  double* lasso =
+      static_cast<double*>(lassoPoints->GetData()->GetVoidPointer(0));
+  std::vector<vtkIdType> selected;
+  std::vector<vtkIdType> candidates;
+  if (!this->VertexGrid->Classify(lasso, numSelectionPoints, bounds, selected,
+      candidates))
+  {
+    candidates.resize(numGraphPoints);
+    for (vtkIdType i = 0; i < numGraphPoints; ++i)
+    {
+      candidates[i] = i;
+    }
+  }
+
   double graphPoint[3];
   double n[3];
-  vtkPolygon::ComputeNormal(graphPoints, n);
-  vtkSmartPointer<vtkIdTypeArray> outPointIds =
-      vtkSmartPointer<vtkIdTypeArray>::New();
-  for (vtkIdType i = 0; i < numGraphPoints; ++i)
+  std::copy(this->VertexGrid->GetNormal(), this->VertexGrid->GetNormal() + 3,
+      n);
+  for (size_t i = 0; i < candidates.size(); ++i)
   {
-    graphPoints->GetPoint(i, graphPoint);
+    graphPoints->GetPoint(candidates[i], graphPoint);
     graphPoint[2] = 0.0;
     int result = vtkPolygon::PointInPolygon(graphPoint, numSelectionPoints,
-        static_cast<double*>(lassoPoints->GetData()->GetVoidPointer(0)),
-        bounds, n);
+        lasso, bounds, n);
     if (result == -1)
     {
       vtkWarningMacro(<< "Lasso select: Degenerate polygon");
@@ -431,9 +715,17 @@ void vtkAnnotatedGraphRepresentation::LassoSelect(vtkPoints* lassoPoints,
     }
     else if (result == 1)
     {
-      outPointIds->InsertNextValue(i);
+      selected.push_back(candidates[i]);
     }
   }
+  std::sort(selected.begin(), selected.end());
+  vtkSmartPointer<vtkIdTypeArray> outPointIds =
+      vtkSmartPointer<vtkIdTypeArray>::New();
+  outPointIds->SetNumberOfTuples(static_cast<vtkIdType>(selected.size()));
+  for (size_t i = 0; i < selected.size(); ++i)
+  {
+    outPointIds->SetValue(static_cast<vtkIdType>(i), selected[i]);
+  }
   if (outPointIds->GetNumberOfTuples() > 0)
   {
     vtkSmartPointer<vtkSelection> selection =
@@ -32,6 +32,9 @@
 #include "vtkRenderedGraphRepresentation.h"
 #include "vtkSmartPointer.h" // for SP ivars
 
+// Private class binning the layout vertices for lasso selection.
+class vtkAnnotatedGraphRepresentationVertexGrid;
+
 class vtkActor;
 class vtkCellCenters;
 class vtkGraphAnnotationLayersFilter;
@@ -82,7 +85,10 @@ public:
 
   // Description:
   // Add an annotation from all the graph points found within the 'lasso',
-  // described as a set of points.
+  // described as a set of points. The vertices are binned in a grid, kept
+  // until the layout changes, so that only those near the edge of the lasso
+  // are tested against it exactly. A degenerate lasso, or layout, selects
+  // nothing.
   void LassoSelect(vtkPoints* lassoPoints, bool);
 
   // Landmarks (annotations layer)
@@ -151,6 +157,8 @@ protected:
   vtkSmartPointer<vtkCellCenters> LandmarkCentres;
   vtkSmartPointer<vtkPointSetToLabelHierarchy> LandmarkLabelHierarchy;
 
+  vtkAnnotatedGraphRepresentationVertexGrid* VertexGrid;
+
 private:
   vtkAnnotatedGraphRepresentation(const vtkAnnotatedGraphRepresentation&); // Not implemented
   void operator=(const vtkAnnotatedGraphRepresentation&);   // Not implemented
@@ -0,0 +1,264 @@
+/*=========================================================================
+
+ Program:   Visualization Toolkit
+ Module:    vtkOffScreenProxyMapper2D.cxx
+
+ Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+ All rights reserved.
+ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+ =========================================================================*/
+
+#include "vtkOffScreenProxyMapper2D.h"
+
+#include "vtkActor2D.h"
+#include "vtkCellArray.h"
+#include "vtkCoordinate.h"
+#include "vtkDataArray.h"
+#include "vtkObjectFactory.h"
+#include "vtkOpenGL.h"
+#include "vtkPointData.h"
+#include "vtkPolyData.h"
+#include "vtkProperty2D.h"
+#include "vtkUnsignedCharArray.h"
+#include "vtkViewport.h"
+#include "vtkWindow.h"
+#include "vtkgluPickMatrix.h"
+
+vtkStandardNewMacro(vtkOffScreenProxyMapper2D)
+vtkCxxSetObjectMacro(vtkOffScreenProxyMapper2D, ProxyTemplate, vtkPolyData)
+vtkCxxSetObjectMacro(vtkOffScreenProxyMapper2D, PointerTemplate, vtkPolyData)
+
+//-----------------------------------------------------------------------------
+vtkOffScreenProxyMapper2D::vtkOffScreenProxyMapper2D()
+{
+  this->ProxyTemplate = 0;
+  this->PointerTemplate = 0;
+  this->ProxyList = 0;
+  this->PointerList = 0;
+  this->ListWindow = 0;
+}
+
+//-----------------------------------------------------------------------------
+vtkOffScreenProxyMapper2D::~vtkOffScreenProxyMapper2D()
+{
+  if (this->ListWindow)
+  {
+    this->ReleaseGraphicsResources(this->ListWindow);
+  }
+  this->SetProxyTemplate(0);
+  this->SetPointerTemplate(0);
+}
+
+//-----------------------------------------------------------------------------
+unsigned long vtkOffScreenProxyMapper2D::GetMTime()
+{
+  unsigned long mTime = this->Superclass::GetMTime();
+  if (this->ProxyTemplate && this->ProxyTemplate->GetMTime() > mTime)
+  {
+    mTime = this->ProxyTemplate->GetMTime();
+  }
+  if (this->PointerTemplate && this->PointerTemplate->GetMTime() > mTime)
+  {
+    mTime = this->PointerTemplate->GetMTime();
+  }
+  return mTime;
+}
+
+//-----------------------------------------------------------------------------
+void vtkOffScreenProxyMapper2D::ReleaseGraphicsResources(vtkWindow* window)
+{
+  if (window && (this->ProxyList || this->PointerList))
+  {
+    window->MakeCurrent();
+    if (this->ProxyList)
+    {
+      glDeleteLists(this->ProxyList, 1);
+    }
+    if (this->PointerList)
+    {
+      glDeleteLists(this->PointerList, 1);
+    }
+  }
+  this->ProxyList = 0;
+  this->PointerList = 0;
+  this->ListWindow = 0;
+  this->Superclass::ReleaseGraphicsResources(window);
+}
+
+//-----------------------------------------------------------------------------
+unsigned int vtkOffScreenProxyMapper2D::CompileTemplate(vtkPolyData* shape)
+{
+  GLuint list = glGenLists(1);
+  glNewList(list, GL_COMPILE);
+
+  vtkPoints* points = shape->GetPoints();
+  vtkIdType npts;
+  vtkIdType* pts;
+  double x[3];
+
+  vtkCellArray* polys = shape->GetPolys();
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+  {
+    glBegin(GL_POLYGON);
+    for (vtkIdType j = 0; j < npts; ++j)
+    {
+      points->GetPoint(pts[j], x);
+      glVertex2d(x[0], x[1]);
+    }
+    glEnd();
+  }
+
+  vtkCellArray* strips = shape->GetStrips();
+  for (strips->InitTraversal(); strips->GetNextCell(npts, pts);)
+  {
+    glBegin(GL_TRIANGLE_STRIP);
+    for (vtkIdType j = 0; j < npts; ++j)
+    {
+      points->GetPoint(pts[j], x);
+      glVertex2d(x[0], x[1]);
+    }
+    glEnd();
+  }
+
+  glEndList();
+  return list;
+}
+
+//-----------------------------------------------------------------------------
+void vtkOffScreenProxyMapper2D::DrawInstances(unsigned int list,
+    vtkDataArray* transforms, vtkUnsignedCharArray* colors,
+    const double actorColor[4])
+{
+  if (!transforms || transforms->GetNumberOfComponents() != 6)
+  {
+    return;
+  }
+
+  // Column-major 4x4 form of the 2x3 placement; only the 2D entries change
+  GLdouble matrix[16] =
+  { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0,
+      1.0 };
+  double m[6];
+
+  glColor4dv(actorColor);
+  vtkIdType numInstances = transforms->GetNumberOfTuples();
+  for (vtkIdType i = 0; i < numInstances; ++i)
+  {
+    transforms->GetTuple(i, m);
+    matrix[0] = m[0];
+    matrix[1] = m[3];
+    matrix[4] = m[1];
+    matrix[5] = m[4];
+    matrix[12] = m[2];
+    matrix[13] = m[5];
+
+    if (colors)
+    {
+      glColor4ubv(colors->GetPointer(4 * i));
+    }
+    glPushMatrix();
+    glMultMatrixd(matrix);
+    glCallList(list);
+    glPopMatrix();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkOffScreenProxyMapper2D::RenderOverlay(vtkViewport* viewport,
+    vtkActor2D* actor)
+{
+  vtkPolyData* input = this->GetInput();
+  if (!input)
+  {
+    vtkErrorMacro(<< "No input!");
+    return;
+  }
+  input->Update();
+  if (input->GetNumberOfPoints() == 0)
+  {
+    return;
+  }
+
+  if (!this->ProxyTemplate || !this->PointerTemplate)
+  {
+    vtkErrorMacro(<< "Proxy and pointer templates must be set.");
+    return;
+  }
+
+  // (Re)compile the templates if they or the window have changed
+  vtkWindow* window = viewport->GetVTKWindow();
+  if (window != this->ListWindow
+      || this->ProxyTemplate->GetMTime() > this->ListTime
+      || this->PointerTemplate->GetMTime() > this->ListTime)
+  {
+    this->ReleaseGraphicsResources(this->ListWindow);
+    this->ProxyList = this->CompileTemplate(this->ProxyTemplate);
+    this->PointerList = this->CompileTemplate(this->PointerTemplate);
+    this->ListWindow = window;
+    this->ListTime.Modified();
+  }
+
+  // Per-instance colours, modulated by the actor opacity
+  vtkProperty2D* property = actor->GetProperty();
+  vtkUnsignedCharArray* colors = this->MapScalars(property->GetOpacity());
+  double actorColor[4];
+  property->GetColor(actorColor);
+  actorColor[3] = property->GetOpacity();
+
+  // Set up display coordinates relative to the actor position
+  int* actorPosition =
+      actor->GetActualPositionCoordinate()->GetComputedViewportValue(viewport);
+  int* size = viewport->GetSize();
+
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  if (viewport->GetIsPicking())
+  {
+    vtkgluPickMatrix(viewport->GetPickX(), viewport->GetPickY(),
+        viewport->GetPickWidth(), viewport->GetPickHeight(),
+        viewport->GetOrigin(), size);
+  }
+
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+
+  if (property->GetDisplayLocation() == VTK_FOREGROUND_LOCATION)
+  {
+    glOrtho(-actorPosition[0], -actorPosition[0] + size[0], -actorPosition[1],
+        -actorPosition[1] + size[1], 0, 1);
+  }
+  else
+  {
+    glOrtho(-actorPosition[0], -actorPosition[0] + size[0], -actorPosition[1],
+        -actorPosition[1] + size[1], -1, 0);
+  }
+
+  glDisable(GL_LIGHTING);
+
+  vtkPointData* pointData = input->GetPointData();
+  this->DrawInstances(this->ProxyList,
+      pointData->GetArray("proxy transform"), colors, actorColor);
+  this->DrawInstances(this->PointerList,
+      pointData->GetArray("pointer transform"), colors, actorColor);
+
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glPopMatrix();
+  glEnable(GL_LIGHTING);
+}
+
+//-----------------------------------------------------------------------------
+void vtkOffScreenProxyMapper2D::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "ProxyTemplate: " << this->ProxyTemplate << endl;
+  os << indent << "PointerTemplate: " << this->PointerTemplate << endl;
+}
@@ -0,0 +1,104 @@
+/*=========================================================================
+
+ Program:   Visualization Toolkit
+ Module:    vtkOffScreenProxyMapper2D.h
+
+ Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+ All rights reserved.
+ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+ =========================================================================*/
+// .NAME vtkOffScreenProxyMapper2D - Draw off-screen proxies as instances of
+// two template meshes.
+//
+// .SECTION Description
+// Every off-screen proxy is the same sector and pointer shape, differing only
+// in its placement and colour. The input of this mapper is the instance
+// output of vtkOffScreenRepresentationImpl (port 2): one point per proxy with
+// a "proxy transform" and a "pointer transform" point array, each a row-major
+// 2x3 affine matrix taking the template to display coordinates. The proxy
+// and pointer templates are compiled once into OpenGL display lists, and each
+// render only sends the two matrices and a colour per proxy.
+//
+// Colours are mapped from the point data of the input as for any other
+// vtkPolyDataMapper2D (e.g. ColorByArrayComponent("Hull color", -1) with
+// SetScalarModeToUsePointFieldData()), modulated by the opacity of the actor.
+// Only fixed-function OpenGL 1.1 is used, so the mapper also works with
+// software implementations such as Mesa llvmpipe, and honours the pick
+// matrix when the viewport is picking.
+//
+// .SEE ALSO
+// vtkOffScreenRepresentationImpl vtkOffScreenRepresentation
+
+#ifndef __vtkOffScreenProxyMapper2D_h
+#define __vtkOffScreenProxyMapper2D_h
+
+#include "vtkcsmWidgetsWin32Header.h"
+#include "vtkPolyDataMapper2D.h"
+
+class vtkDataArray;
+class vtkPolyData;
+class vtkUnsignedCharArray;
+class vtkWindow;
+
+
+class VTK_CSM_WIDGETS_EXPORT vtkOffScreenProxyMapper2D:
+  public vtkPolyDataMapper2D
+{
+public:
+  static vtkOffScreenProxyMapper2D *New();
+  vtkTypeMacro(vtkOffScreenProxyMapper2D, vtkPolyDataMapper2D)
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Description:
+  // Set/Get the meshes drawn for each instance, in template coordinates.
+  void SetProxyTemplate(vtkPolyData* proxyTemplate);
+  vtkGetObjectMacro(ProxyTemplate, vtkPolyData)
+  void SetPointerTemplate(vtkPolyData* pointerTemplate);
+  vtkGetObjectMacro(PointerTemplate, vtkPolyData)
+
+  // Description:
+  // Draw the instances.
+  virtual void RenderOverlay(vtkViewport* viewport, vtkActor2D* actor);
+
+  // Description:
+  // Release the display lists.
+  virtual void ReleaseGraphicsResources(vtkWindow* window);
+
+  // Description:
+  // Include the templates in the modified time.
+  virtual unsigned long GetMTime();
+
+protected:
+  vtkOffScreenProxyMapper2D();
+  ~vtkOffScreenProxyMapper2D();
+
+  // Description:
+  // Compile the polygons and triangle strips of a template into a display
+  // list, returning its name.
+  unsigned int CompileTemplate(vtkPolyData* shape);
+
+  // Description:
+  // Draw the template list once for every instance, placed by the 2x3
+  // matrices in transforms.
+  void DrawInstances(unsigned int list, vtkDataArray* transforms,
+      vtkUnsignedCharArray* colors, const double actorColor[4]);
+
+  vtkPolyData* ProxyTemplate;
+  vtkPolyData* PointerTemplate;
+
+  unsigned int ProxyList;
+  unsigned int PointerList;
+  vtkWindow* ListWindow;
+  vtkTimeStamp ListTime;
+
+private:
+  vtkOffScreenProxyMapper2D(const vtkOffScreenProxyMapper2D&); // Not implemented.
+  void operator=(const vtkOffScreenProxyMapper2D&);  // Not implemented.
+};
+
+#endif // __vtkOffScreenProxyMapper2D_h
@@ -18,10 +18,10 @@
 #include "vtkActor.h"
 #include "vtkActor2D.h"
 #include "vtkCellArray.h"
-#include "vtkCellData.h"
 #include "vtkCellCenters.h"
 #include "vtkInteractorObserver.h"
 #include "vtkObjectFactory.h"
+#include "vtkOffScreenProxyMapper2D.h"
 #include "vtkOffScreenRepresentationImpl.h"
 #include "vtkPoints.h"
 #include "vtkPolyData.h"
@@ -34,9 +34,10 @@
 #include "vtkTextActor.h"
 #include "vtkTextMapper.h"
 #include "vtkTextProperty.h"
-#include "vtkUnsignedCharArray.h"
 #include "vtkWindow.h"
 
+#include <algorithm>
+
 //----------------------------------------------------------------------
 vtkStandardNewMacro(vtkOffScreenRepresentation)
 vtkCxxSetObjectMacro(vtkOffScreenRepresentation, TextProperty, vtkTextProperty)
@@ -52,6 +53,7 @@ vtkOffScreenRepresentation::vtkOffScreenRepresentation()
   this->BezelVisible = 1;
   this->ProxiesVisible = 1;
   this->BezelOpacity = 0.25;
+  this->InstancedProxies = false;
   this->HoverText = 0;
 
   // Controlling layout
@@ -117,6 +119,7 @@ vtkOffScreenRepresentation::vtkOffScreenRepresentation()
   this->ProjectOffScreen =
       vtkSmartPointer<vtkOffScreenRepresentationImpl>::New();
   this->ProxyMapper = vtkSmartPointer<vtkPolyDataMapper2D>::New();
+  this->ProxyInstanceMapper = vtkSmartPointer<vtkOffScreenProxyMapper2D>::New();
   this->ProxyActor = vtkSmartPointer<vtkActor2D>::New();
   this->BezelMapper = vtkSmartPointer<vtkPolyDataMapper2D>::New();
   this->BezelActor = vtkSmartPointer<vtkActor2D>::New();
@@ -132,6 +135,17 @@ vtkOffScreenRepresentation::vtkOffScreenRepresentation()
   this->ProxyMapper->ColorByArrayComponent(const_cast<char*>("Hull color"), -1);
   this->ProxyMapper->SetScalarModeToUseCellFieldData();
   this->ProxyMapper->SetScalarVisibility(true);
+
+  this->ProxyInstanceMapper->SetInputConnection(
+      this->ProjectOffScreen->GetOutputPort(2));
+  this->ProxyInstanceMapper->SetProxyTemplate(
+      this->ProjectOffScreen->GetProxyTemplate());
+  this->ProxyInstanceMapper->SetPointerTemplate(
+      this->ProjectOffScreen->GetPointerTemplate());
+  this->ProxyInstanceMapper->ColorByArrayComponent(
+      const_cast<char*>("Hull color"), -1);
+  this->ProxyInstanceMapper->SetScalarModeToUsePointFieldData();
+  this->ProxyInstanceMapper->SetScalarVisibility(true);
   this->ProxyActor->SetLayerNumber(0);
   this->ProxyActor->SetPickable(true);
 
@@ -211,42 +225,42 @@ void vtkOffScreenRepresentation::EndWidgetInteraction(double vtkNotUsed(e)[2])
 //----------------------------------------------------------------------
 void vtkOffScreenRepresentation::RestoreDim()
 {
-  this->BezelActor->GetProperty()->SetOpacity(this->BezelOpacity);
-  // Set the LandmarkCenters to modified to restore the proxy opacity
-  this->LandmarkCentres->Modified();
+  // Dimming only ever changes the actor opacities, so there is nothing to
+  // do unless they have been changed
+  vtkProperty2D* bezelProperty = this->BezelActor->GetProperty();
+  vtkProperty2D* proxyProperty = this->ProxyActor->GetProperty();
+  if (bezelProperty->GetOpacity() == this->BezelOpacity
+      && proxyProperty->GetOpacity() == 1.0)
+  {
+    return;
+  }
+  bezelProperty->SetOpacity(this->BezelOpacity);
+  proxyProperty->SetOpacity(1.0);
   this->Modified();
 }
 
 //----------------------------------------------------------------------
 void vtkOffScreenRepresentation::DimSubtract(double amount)
 {
-  this->BezelActor->GetProperty()->SetOpacity(
-      this->BezelActor->GetProperty()->GetOpacity() - amount);
-  this->ProxyActor->GetProperty()->SetOpacity(
-      this->BezelActor->GetProperty()->GetOpacity() - amount);
+  vtkProperty2D* bezelProperty = this->BezelActor->GetProperty();
+  vtkProperty2D* proxyProperty = this->ProxyActor->GetProperty();
+  bezelProperty->SetOpacity(
+      std::max(bezelProperty->GetOpacity() - amount, 0.0));
+  proxyProperty->SetOpacity(
+      std::max(proxyProperty->GetOpacity() - amount, 0.0));
   this->Modified();
 }
 
 //----------------------------------------------------------------------
 void vtkOffScreenRepresentation::DimMultiply(double amount)
 {
-  this->BezelActor->GetProperty()->SetOpacity(
-      this->BezelActor->GetProperty()->GetOpacity() * amount);
-
-  vtkUnsignedCharArray* colors = vtkUnsignedCharArray::SafeDownCast(
-      this->ProjectOffScreen->GetOutput()->GetCellData()->GetAbstractArray(
-          "Hull color"));
-
-  if (colors)
-  {
-    unsigned char oldColour[4];
-    for (vtkIdType i = 0; i < colors->GetNumberOfTuples(); ++i)
-    {
-      colors->GetTupleValue(i, oldColour);
-      oldColour[3] *= amount;
-      colors->SetTupleValue(i, oldColour);
-    }
-  }
+  // The proxy mappers scale the alpha of the "Hull color" of every proxy by
+  // the opacity of the actor as they map it, so the outputs of the
+  // projection are left untouched
+  vtkProperty2D* bezelProperty = this->BezelActor->GetProperty();
+  vtkProperty2D* proxyProperty = this->ProxyActor->GetProperty();
+  bezelProperty->SetOpacity(bezelProperty->GetOpacity() * amount);
+  proxyProperty->SetOpacity(proxyProperty->GetOpacity() * amount);
   this->Modified();
 }
 
@@ -353,6 +367,8 @@ void vtkOffScreenRepresentation::ReleaseGraphicsResources(vtkWindow *w)
   this->FlightPathActor->ReleaseGraphicsResources(w);
 
   this->ProxyActor->ReleaseGraphicsResources(w);
+  this->ProxyMapper->ReleaseGraphicsResources(w);
+  this->ProxyInstanceMapper->ReleaseGraphicsResources(w);
   this->BezelActor->ReleaseGraphicsResources(w);
 }
 
@@ -509,6 +525,48 @@ bool vtkOffScreenRepresentation::GetShowError()
   return this->ProjectOffScreen->GetShowError();
 }
 
+//----------------------------------------------------------------------
+void vtkOffScreenRepresentation::SetAggregateProxies(bool b)
+{
+  this->ProjectOffScreen->SetAggregateProxies(b);
+}
+
+//----------------------------------------------------------------------
+bool vtkOffScreenRepresentation::GetAggregateProxies()
+{
+  return this->ProjectOffScreen->GetAggregateProxies();
+}
+
+//----------------------------------------------------------------------
+void vtkOffScreenRepresentation::SetExpandedProxyBin(int bin)
+{
+  this->ProjectOffScreen->SetExpandedProxyBin(bin);
+}
+
+//----------------------------------------------------------------------
+int vtkOffScreenRepresentation::GetExpandedProxyBin()
+{
+  return this->ProjectOffScreen->GetExpandedProxyBin();
+}
+
+//----------------------------------------------------------------------
+void vtkOffScreenRepresentation::SetInstancedProxies(bool b)
+{
+  if (this->InstancedProxies != b)
+  {
+    this->InstancedProxies = b;
+    if (b)
+    {
+      this->ProxyActor->SetMapper(this->ProxyInstanceMapper);
+    }
+    else
+    {
+      this->ProxyActor->SetMapper(this->ProxyMapper);
+    }
+    this->Modified();
+  }
+}
+
 //----------------------------------------------------------------------
 vtkPolyData* vtkOffScreenRepresentation::GetOffScreenPoly()
 {
@@ -537,6 +595,8 @@ void vtkOffScreenRepresentation::PrintSelf(ostream& os, vtkIndent indent)
   }
 
   os << indent << "Padding: " << this->Padding << "\n";
+  os << indent << "Instanced Proxies: "
+      << (this->InstancedProxies ? "On\n" : "Off\n");
   os << indent << "Offset: (" << this->Offset[0] << "," << this->Offset[1]
                                                                         << ")\n";
 
@@ -34,6 +34,7 @@ class vtkActor;
 class vtkActor2D;
 class vtkCellArray;
 class vtkCellCenters;
+class vtkOffScreenProxyMapper2D;
 class vtkOffScreenRepresentationImpl;
 class vtkPoints;
 class vtkProperty2D;
@@ -117,7 +118,9 @@ public:
   void UnHighlightFlightPath();
 
   // Description:
-  // Modify the 'dimness' of the widget.
+  // Modify the 'dimness' of the widget. Only the opacity of the bezel and
+  // proxy actors is changed, so dimming neither re-executes the off-screen
+  // projection nor rewrites its colours.
   void RestoreDim();
   void DimSubtract(double amount);
   void DimMultiply(double amount);
@@ -148,6 +151,26 @@ public:
   void SetShowError(bool b);
   bool GetShowError();
 
+  // Description:
+  // Get/Set whether to collapse proxies that share an angular and distance
+  // bin into one aggregate proxy (see vtkOffScreenRepresentationImpl).
+  void SetAggregateProxies(bool b);
+  bool GetAggregateProxies();
+
+  // Description:
+  // Get/Set the aggregate bin shown as individual proxies, or -1 for none.
+  void SetExpandedProxyBin(int bin);
+  int GetExpandedProxyBin();
+
+  // Description:
+  // When on, the proxies are drawn by vtkOffScreenProxyMapper2D as instances
+  // of one proxy and one pointer mesh, so only a placement and a colour per
+  // proxy is sent to OpenGL on each render. Picking is unaffected. Default
+  // off.
+  void SetInstancedProxies(bool b);
+  vtkGetMacro(InstancedProxies, bool)
+  vtkBooleanMacro(InstancedProxies, bool)
+
   // Description:
   // Get bits of the representation needed for picking etc. in vtkOffScreenWidget.
   vtkPolyData* GetOffScreenPoly();
@@ -157,7 +180,8 @@ public:
   // Set the "world size": usually this is the length of the diagonal of the
   // bounding box of the scene in world coordinates. This measure is used to
   // scale the proxies so that their maximum possible length reflects the
-  // maximum possible distance of an off-screen target.
+  // maximum possible distance of an off-screen target. If 0 (the default),
+  // the diagonal of the bounds of the landmark centres is used.
   void SetWorldSize(double s);
 
 protected:
@@ -195,6 +219,7 @@ protected:
   vtkCellCenters* LandmarkCentres;
   vtkSmartPointer<vtkOffScreenRepresentationImpl> ProjectOffScreen;
   vtkSmartPointer<vtkPolyDataMapper2D> ProxyMapper;
+  vtkSmartPointer<vtkOffScreenProxyMapper2D> ProxyInstanceMapper;
   vtkSmartPointer<vtkActor2D> ProxyActor;
   vtkSmartPointer<vtkPolyDataMapper2D> BezelMapper;
   vtkSmartPointer<vtkActor2D> BezelActor;
@@ -207,6 +232,7 @@ protected:
   int BezelVisible;
   int ProxiesVisible;
   double BezelOpacity;
+  bool InstancedProxies;
 
 private:
   vtkOffScreenRepresentation(const vtkOffScreenRepresentation&); //Not implemented
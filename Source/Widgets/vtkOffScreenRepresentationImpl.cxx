@@ -34,8 +34,11 @@
 #include "vtkRenderer.h"
 #include "vtkTransform.h"
 #include "vtkTransformFilter.h"
+#include "vtkUnsignedCharArray.h"
 
 #include <algorithm>
+#include <cmath>
+#include <vector>
 
 
 //-----------------------------------------------------------------------------
@@ -47,7 +50,11 @@ struct CoronaScopeProxy
   double WorldPoint[2];
   double Error;
   double DistanceInWorld;
-  vtkSmartPointer<vtkPolyData> Representation;
+
+  // The number of off-screen points the proxy stands for, and the bin they
+  // were aggregated in (-1 when not aggregating).
+  int Count;
+  int Bin;
 
   //---------------------------------------------------------------------------
   // Description:
@@ -91,19 +98,49 @@ struct CoronaScopeProxySortFunctor
   }
 } CoronaScopeProxySort;
 
+//-----------------------------------------------------------------------------
+// Description:
+// Orders the proxies of a bin by colour, then distance, so that each colour
+// is a contiguous run.
+struct CoronaScopeBinKey
+{
+  int Bin;
+  unsigned int Colour;
+  double Distance;
+  size_t Index;
+
+  bool operator<(const CoronaScopeBinKey& other) const
+  {
+    if (this->Bin != other.Bin)
+    {
+      return this->Bin < other.Bin;
+    }
+    if (this->Colour != other.Colour)
+    {
+      return this->Colour < other.Colour;
+    }
+    return this->Distance < other.Distance;
+  }
+};
+
 //-----------------------------------------------------------------------------
 // Description:
 // A segment is used to contain any number of overlapping proxies and provides
-// methods for calculating the forward (clockwise edge of a segment) and reverse
-// (anticlockwise/counterclockwise edge) extents, both before and after expansion
-// of the space required to remove overlaps.
+// methods for calculating the forward (anticlockwise edge of a segment) and
+// reverse (clockwise edge) extents after expansion to the space required to
+// remove overlaps. The proxies are the index range [Begin, End) of the
+// angle-sorted proxies. A segment that wraps through 0 degrees ends past the
+// last proxy: index i then stands for proxy i - n, one turn further round.
 struct CoronaScopeSegment
 {
-  std::vector<CoronaScopeProxy*> proxies;
+  size_t Begin;
+  size_t End;
+  double Centre;
   double spacing;
   double width;
-  CoronaScopeSegment(double spacing, double width) :
-    spacing(spacing), width(width)
+  CoronaScopeSegment(size_t begin, size_t end, double centre, double spacing,
+      double width) :
+    Begin(begin), End(end), Centre(centre), spacing(spacing), width(width)
   {
   }
 
@@ -112,70 +149,413 @@ struct CoronaScopeSegment
   void PrintDebugInfo(ostream& os) const
   {
     os << "Expanded-forward: " << this->GetExpandedForwardExtent() << " "
-        << "Forward: " << this->GetForwardExtent() << " " << "Centre: "
-        << this->GetCentre() << " " << "Reverse: " << this->GetReverseExtent()
-        << " " << "Expanded-reverse: " << this->GetExpandedReverseExtent()
-        << " " << "Expanded-width: " << this->GetExpandedWidth() << endl;
+        << "Centre: " << this->Centre << " " << "Expanded-reverse: "
+        << this->GetExpandedReverseExtent() << " " << "Expanded-width: "
+        << this->GetExpandedWidth() << " " << "Proxies: [" << this->Begin
+        << ", " << this->End << ")" << endl;
+  }
+
+  // Description:
+  // The forward (anticlockwise) extent of the segment after expansion.
+  double GetExpandedForwardExtent() const
+  {
+    return this->Centre + this->GetExpandedWidth() / 2.0;
+  }
+
+  // Description:
+  // The reverse (clockwise) extent of the segment after expansion. Can
+  // return a negative angle if the centre is close to zero degrees.
+  double GetExpandedReverseExtent() const
+  {
+    return this->Centre - this->GetExpandedWidth() / 2.0;
+  }
+
+  // Description:
+  // The total width of the segment after expansion, i.e. the width * number of
+  // proxies plus spacing.
+  double GetExpandedWidth() const
+  {
+    return (this->width + this->spacing) * (this->End - this->Begin);
+  }
+
+  // Description:
+  // Whether the expanded segment overlaps the expanded next segment.
+  bool Overlaps(const CoronaScopeSegment& next) const
+  {
+    return this->GetExpandedForwardExtent() > next.GetExpandedReverseExtent();
+  }
+};
+
+//-----------------------------------------------------------------------------
+// Description:
+// The original angle of the proxy at index i of the sorted proxies, one turn
+// further round for indices past the end.
+static inline double CoronaScopeUnwrappedAngle(
+    const std::vector<double>& angles, size_t i)
+{
+  size_t n = angles.size();
+  return angles[i % n] + 360.0 * static_cast<double>(i / n);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+// Join a segment with the one that follows it. The joined segment is centred
+// on the middle of the original extent of its proxies.
+static inline CoronaScopeSegment CoronaScopeMergeSegments(
+    const std::vector<double>& angles, const CoronaScopeSegment& segment,
+    const CoronaScopeSegment& next)
+{
+  double centre = (CoronaScopeUnwrappedAngle(angles, segment.Begin)
+      + CoronaScopeUnwrappedAngle(angles, next.End - 1)) / 2.0;
+  return CoronaScopeSegment(segment.Begin, next.End, centre, segment.spacing,
+      segment.width);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+// Copy x and y of interleaved xyz coordinates into separate arrays.
+template<class T>
+void vtkOffScreenRepresentationImplCopyCoordinates(const T* xyz, vtkIdType n,
+    double* x, double* y)
+{
+  for (vtkIdType i = 0; i < n; ++i)
+  {
+    x[i] = static_cast<double>(xyz[3 * i]);
+    y[i] = static_cast<double>(xyz[3 * i + 1]);
+  }
+}
 
-    for (size_t i = 0; i < proxies.size(); ++i)
+//-----------------------------------------------------------------------------
+// Description:
+// The shape of a sector source, kept as flat x, y coordinates and the
+// connectivity of its polygons and triangle strips, so that a glyph can be
+// written straight into the output for every proxy. Placing a glyph rotates
+// and stretches the template analytically rather than through vtkTransform.
+struct vtkOffScreenRepresentationImplGlyphTemplate
+{
+  vtkPolyData* Shape;
+  std::vector<double> Points;
+  std::vector<vtkIdType> Polys;
+  vtkIdType NumberOfPolys;
+  std::vector<vtkIdType> Strips;
+  vtkIdType NumberOfStrips;
+  vtkTimeStamp BuildTime;
+
+  vtkOffScreenRepresentationImplGlyphTemplate() :
+    Shape(0), NumberOfPolys(0), NumberOfStrips(0)
+  {
+  }
+
+  vtkIdType GetNumberOfPoints() const
+  {
+    return static_cast<vtkIdType>(this->Points.size() / 2);
+  }
+
+  // Description:
+  // Copy the output of source unless the copy is up to date.
+  void Update(vtkSectorSource* source)
+  {
+    if (source->GetMTime() <= this->BuildTime.GetMTime())
+    {
+      return;
+    }
+
+    source->Update();
+    vtkPolyData* shape = source->GetOutput();
+    this->Shape = shape;
+    vtkIdType numPoints = shape->GetNumberOfPoints();
+    this->Points.resize(2 * numPoints);
+    double point[3];
+    for (vtkIdType i = 0; i < numPoints; ++i)
     {
-      cout << proxies[i]->GetAngleInDegrees() << " ";
+      shape->GetPoint(i, point);
+      this->Points[2 * i] = point[0];
+      this->Points[2 * i + 1] = point[1];
     }
-    cout << endl;
+    this->NumberOfPolys = CopyCells(shape->GetPolys(), this->Polys);
+    this->NumberOfStrips = CopyCells(shape->GetStrips(), this->Strips);
+
+    this->BuildTime.Modified();
   }
 
   // Description:
-  // The forward (anticlockwise) extent of the segment without expansion.
-  double GetForwardExtent() const
+  // Compute the 2x3 affine placement (row major) that rotates a template
+  // point by error about (pivot, 0), stretches it along x by stretch away
+  // from x = pivot, rotates it by rotate about the origin and finally scales
+  // it by scale and moves it to centre. Angles are in radians.
+  static void ComputePlacement(double rotate, double error, double stretch,
+      double pivot, const double centre[2], double scale, double m[6])
   {
-    return this->proxies[0]->GetAngleInDegrees() + width / 2.0;
+    double cosRotate = cos(rotate);
+    double sinRotate = sin(rotate);
+    double cosError = cos(error);
+    double sinError = sin(error);
+
+    double a00 = cosRotate * stretch * cosError - sinRotate * sinError;
+    double a01 = -cosRotate * stretch * sinError - sinRotate * cosError;
+    double a10 = sinRotate * stretch * cosError + cosRotate * sinError;
+    double a11 = -sinRotate * stretch * sinError + cosRotate * cosError;
+
+    m[0] = scale * a00;
+    m[1] = scale * a01;
+    m[2] = centre[0] + scale * (cosRotate - a00) * pivot;
+    m[3] = scale * a10;
+    m[4] = scale * a11;
+    m[5] = centre[1] + scale * (sinRotate - a10) * pivot;
   }
 
   // Description:
-  // The reverse (clockwise) extent of the segment. Can return a negative angle
-  // if centre() is close to zero degrees.
-  double GetReverseExtent() const
+  // Write the template points, placed by m, to xyz.
+  void Place(const double m[6], float* xyz) const
   {
-    return this->proxies[this->proxies.size() - 1]->GetAngleInDegrees()
-        - width / 2.0;
+    vtkIdType numPoints = this->GetNumberOfPoints();
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+      double x = this->Points[2 * i];
+      double y = this->Points[2 * i + 1];
+      xyz[3 * i] = static_cast<float>(m[0] * x + m[1] * y + m[2]);
+      xyz[3 * i + 1] = static_cast<float>(m[3] * x + m[4] * y + m[5]);
+      xyz[3 * i + 2] = 0.0f;
+    }
   }
 
   // Description:
-  // The centre of the segment.
-  double GetCentre() const
+  // Append the template cells, with point ids shifted by offset, to the
+  // connectivity arrays at polys and strips and advance both pointers.
+  void InsertCells(vtkIdType offset, vtkIdType*& polys,
+      vtkIdType*& strips) const
+  {
+    polys = ShiftCells(this->Polys, offset, polys);
+    strips = ShiftCells(this->Strips, offset, strips);
+  }
+
+  static vtkIdType CopyCells(vtkCellArray* cells,
+      std::vector<vtkIdType>& connectivity)
+  {
+    vtkIdType size = cells->GetNumberOfConnectivityEntries();
+    connectivity.resize(size);
+    if (size > 0)
+    {
+      std::copy(cells->GetPointer(), cells->GetPointer() + size,
+          connectivity.begin());
+    }
+    return cells->GetNumberOfCells();
+  }
+
+  static vtkIdType* ShiftCells(const std::vector<vtkIdType>& connectivity,
+      vtkIdType offset, vtkIdType* out)
   {
-    // Ensure the left/right distances are interpreted the right way around:
-    // without this the centre is ~180 degrees out
-    double right = this->GetReverseExtent();
-    if (this->GetForwardExtent() - right > this->GetExpandedWidth())
+    size_t size = connectivity.size();
+    size_t i = 0;
+    while (i < size)
     {
-      right -= 360.0;
+      vtkIdType npts = connectivity[i];
+      *out++ = npts;
+      ++i;
+      for (vtkIdType j = 0; j < npts; ++j, ++i)
+      {
+        *out++ = connectivity[i] + offset;
+      }
     }
-    return right + (this->GetForwardExtent() - right) / 2.0;
+    return out;
+  }
+};
+
+//-----------------------------------------------------------------------------
+// Description:
+// All the outputs take from the renderer: the display size and the world
+// coordinates of its corners. The input and the parameters of the filter
+// are tracked by the pipeline as usual.
+struct vtkOffScreenRepresentationImplViewSignature
+{
+  int Size[2];
+  double Bounds[4];
+
+  bool operator==(const vtkOffScreenRepresentationImplViewSignature& other) const
+  {
+    return this->Size[0] == other.Size[0] && this->Size[1] == other.Size[1]
+        && this->Bounds[0] == other.Bounds[0]
+        && this->Bounds[1] == other.Bounds[1]
+        && this->Bounds[2] == other.Bounds[2]
+        && this->Bounds[3] == other.Bounds[3];
+  }
+};
+
+//-----------------------------------------------------------------------------
+// Description:
+// Holds the x and y coordinates of the input points as separate arrays,
+// refreshed only when the points change, and the buffers used to cull them.
+// Keeping the coordinates apart lets the compiler vectorise the rectangle
+// test; the ids of the points that fail it are then compacted without
+// branches.
+class vtkOffScreenRepresentationImplInternals
+{
+public:
+  vtkOffScreenRepresentationImplInternals() :
+    Points(0), EstimatedWorldSize(1.0), HasView(false), RendererTime(0)
+  {
   }
 
   // Description:
-  // The forward (anticlockwise) extent of the segment after expansion. Can
-  // return a negative angle if centre() is close to zero degrees.
-  double GetExpandedForwardExtent() const
+  // Copy the coordinates of points into X and Y unless they are up to date.
+  void UpdateCoordinates(vtkPoints* points)
   {
-    return this->GetCentre() + this->GetExpandedWidth() / 2.0;
+    if (points == this->Points
+        && points->GetMTime() <= this->CoordinateTime.GetMTime())
+    {
+      return;
+    }
+
+    vtkIdType numPoints = points->GetNumberOfPoints();
+    this->X.resize(numPoints);
+    this->Y.resize(numPoints);
+    this->Outside.resize(numPoints);
+    this->OffScreenIds.resize(numPoints);
+    if (numPoints > 0)
+    {
+      switch (points->GetDataType())
+      {
+      case VTK_FLOAT:
+        vtkOffScreenRepresentationImplCopyCoordinates(
+            static_cast<float*>(points->GetVoidPointer(0)), numPoints,
+            &this->X[0], &this->Y[0]);
+        break;
+      case VTK_DOUBLE:
+        vtkOffScreenRepresentationImplCopyCoordinates(
+            static_cast<double*>(points->GetVoidPointer(0)), numPoints,
+            &this->X[0], &this->Y[0]);
+        break;
+      default:
+        double point[3];
+        for (vtkIdType i = 0; i < numPoints; ++i)
+        {
+          points->GetPoint(i, point);
+          this->X[i] = point[0];
+          this->Y[i] = point[1];
+        }
+      }
+    }
+
+    this->EstimateWorldSize();
+    this->Points = points;
+    this->CoordinateTime.Modified();
   }
 
   // Description:
-  // The reverse (clockwise) extent of the segment after expansion.
-  double GetExpandedReverseExtent() const
+  // Set EstimatedWorldSize to the diagonal of the bounds of X and Y, or to 1
+  // if there are fewer than two distinct points.
+  void EstimateWorldSize()
   {
-    return this->GetCentre() - this->GetExpandedWidth() / 2.0;
+    size_t numPoints = this->X.size();
+    this->EstimatedWorldSize = 1.0;
+    if (numPoints == 0)
+    {
+      return;
+    }
+
+    double bounds[4] =
+    { this->X[0], this->X[0], this->Y[0], this->Y[0] };
+    for (size_t i = 1; i < numPoints; ++i)
+    {
+      bounds[0] = std::min(bounds[0], this->X[i]);
+      bounds[1] = std::max(bounds[1], this->X[i]);
+      bounds[2] = std::min(bounds[2], this->Y[i]);
+      bounds[3] = std::max(bounds[3], this->Y[i]);
+    }
+    double dx = bounds[1] - bounds[0];
+    double dy = bounds[3] - bounds[2];
+    double diagonal = sqrt(dx * dx + dy * dy);
+    if (diagonal > 0.0)
+    {
+      this->EstimatedWorldSize = diagonal;
+    }
   }
 
   // Description:
-  // The total width of the segment after expansion, i.e. the width * number of
-  // proxies plus spacing.
-  double GetExpandedWidth() const
+  // Write the ids of the points outside the open rectangle between
+  // leftBottom and rightTop to OffScreenIds and return their number.
+  vtkIdType Cull(const double leftBottom[2], const double rightTop[2])
+  {
+    vtkIdType numPoints = static_cast<vtkIdType>(this->X.size());
+    if (numPoints == 0)
+    {
+      return 0;
+    }
+
+    const double left = leftBottom[0];
+    const double bottom = leftBottom[1];
+    const double right = rightTop[0];
+    const double top = rightTop[1];
+    const double* x = &this->X[0];
+    const double* y = &this->Y[0];
+    unsigned char* outside = &this->Outside[0];
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+      outside[i] = static_cast<unsigned char>((x[i] <= left)
+          | (x[i] >= right) | (y[i] <= bottom) | (y[i] >= top));
+    }
+
+    vtkIdType* ids = &this->OffScreenIds[0];
+    vtkIdType count = 0;
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+      ids[count] = i;
+      count += outside[i];
+    }
+    return count;
+  }
+
+  // Description:
+  // Refresh and return the proxy and pointer glyph templates.
+  const vtkOffScreenRepresentationImplGlyphTemplate& UpdateProxyTemplate(
+      vtkSectorSource* source)
+  {
+    this->ProxyTemplate.Update(source);
+    return this->ProxyTemplate;
+  }
+  const vtkOffScreenRepresentationImplGlyphTemplate& UpdatePointerTemplate(
+      vtkSectorSource* source)
+  {
+    this->PointerTemplate.Update(source);
+    return this->PointerTemplate;
+  }
+
+  std::vector<double> X;
+  std::vector<double> Y;
+  std::vector<unsigned char> Outside;
+  std::vector<vtkIdType> OffScreenIds;
+
+  // The points X and Y were copied from, compared only.
+  vtkPoints* Points;
+  vtkTimeStamp CoordinateTime;
+
+  // The world size used when none is set, kept with the coordinates.
+  double EstimatedWorldSize;
+
+  // Description:
+  // Record the current view, and modify ViewTime if it differs from the
+  // last one recorded. Returns whether it did.
+  bool UpdateView(const vtkOffScreenRepresentationImplViewSignature& view)
   {
-    return (this->width + this->spacing) * this->proxies.size();
+    if (this->HasView && view == this->View)
+    {
+      return false;
+    }
+    this->View = view;
+    this->HasView = true;
+    this->ViewTime.Modified();
+    return true;
   }
+
+  vtkOffScreenRepresentationImplGlyphTemplate ProxyTemplate;
+  vtkOffScreenRepresentationImplGlyphTemplate PointerTemplate;
+
+  // The last view seen, when it changed, and the renderer time it was seen
+  // at.
+  vtkOffScreenRepresentationImplViewSignature View;
+  bool HasView;
+  vtkTimeStamp ViewTime;
+  unsigned long RendererTime;
 };
 
 vtkStandardNewMacro(vtkOffScreenRepresentationImpl)
@@ -191,8 +571,14 @@ vtkOffScreenRepresentationImpl::vtkOffScreenRepresentationImpl()
   this->Resolution = 16;
   this->ReduceOverlaps = false;
   this->ShowError = false;
-
-  this->SetNumberOfOutputPorts(2);
+  this->AggregateProxies = false;
+  this->NumberOfAggregationBins = 120;
+  this->NumberOfDistanceBins = 3;
+  this->ExpandedProxyBin = -1;
+  this->NumberOfViewCacheHits = 0;
+  this->NumberOfViewCacheMisses = 0;
+
+  this->SetNumberOfOutputPorts(3);
   this->Coordinate = vtkSmartPointer<vtkCoordinate>::New();
   this->EmptyPolyData = vtkSmartPointer<vtkPolyData>::New();
 
@@ -203,14 +589,7 @@ vtkOffScreenRepresentationImpl::vtkOffScreenRepresentationImpl()
   this->BezelAppend = vtkSmartPointer<vtkAppendPolyData>::New();
 
   this->ProxySource = vtkSmartPointer<vtkSectorSource>::New();
-  this->ProxySourceTransform = vtkSmartPointer<vtkTransform>::New();
   this->PointerSource = vtkSmartPointer<vtkSectorSource>::New();
-  this->PointerSourceTransform = vtkSmartPointer<vtkTransform>::New();
-  this->PointerAppend = vtkSmartPointer<vtkAppendPolyData>::New();
-
-  this->ProxyTransform = vtkSmartPointer<vtkTransform>::New();
-  this->ProxyTransformFilter = vtkSmartPointer<vtkTransformFilter>::New();
-  this->ProxyAppend = vtkSmartPointer<vtkAppendPolyData>::New();
 
   this->BezelSource->SetOuterRadius(this->OuterBezelRadius);
   this->BezelSource->SetInnerRadius(this->InnerBezelRadius);
@@ -241,36 +620,66 @@ vtkOffScreenRepresentationImpl::vtkOffScreenRepresentationImpl()
   this->PointerSource->SetRadialResolution(1);
   this->PointerSource->Update();
 
-  this->ProxyTransformFilter->SetInputConnection(
-      this->ProxyAppend->GetOutputPort());
-  this->ProxyTransformFilter->SetTransform(this->ProxyTransform);
+  this->Internals = new vtkOffScreenRepresentationImplInternals;
 }
 
 //-----------------------------------------------------------------------------
 vtkOffScreenRepresentationImpl::~vtkOffScreenRepresentationImpl()
 {
   this->SetRenderer(0);
+  delete this->Internals;
 }
 
 //-----------------------------------------------------------------------------
 void vtkOffScreenRepresentationImpl::SetRenderer(vtkRenderer* renderer)
 {
-  this->Renderer = renderer;
+  if (this->Renderer != renderer)
+  {
+    this->Renderer = renderer;
+    this->Modified();
+  }
 }
 
 //-----------------------------------------------------------------------------
 unsigned long vtkOffScreenRepresentationImpl::GetMTime()
 {
-  if (this->Renderer)
+  if (!this->Renderer)
   {
-    return
-        this->Renderer->GetMTime() > this->MTime ?
-            this->Renderer->GetMTime() : this->MTime;
+    return this->MTime;
   }
-  else
+
+  // The renderer is modified by much more than changes to the view, so only
+  // the view itself is compared.
+  vtkOffScreenRepresentationImplViewSignature view;
+  int* size = this->Renderer->GetSize();
+  view.Size[0] = size[0];
+  view.Size[1] = size[1];
+  view.Bounds[0] = view.Bounds[1] = view.Bounds[2] = view.Bounds[3] = 0.0;
+  if (view.Size[0] > 0 && view.Size[1] > 0)
   {
-    return this->MTime;
+    int displayLeftBottom[2] =
+    { 0, 0 };
+    double* coord = this->DisplayToWorld(displayLeftBottom);
+    view.Bounds[0] = coord[0];
+    view.Bounds[1] = coord[1];
+    coord = this->DisplayToWorld(view.Size);
+    view.Bounds[2] = coord[0];
+    view.Bounds[3] = coord[1];
+  }
+
+  unsigned long rendererTime = this->Renderer->GetMTime();
+  if (this->Internals->UpdateView(view))
+  {
+    ++this->NumberOfViewCacheMisses;
   }
+  else if (rendererTime > this->Internals->RendererTime)
+  {
+    ++this->NumberOfViewCacheHits;
+  }
+  this->Internals->RendererTime = rendererTime;
+
+  unsigned long viewTime = this->Internals->ViewTime.GetMTime();
+  return viewTime > this->MTime ? viewTime : this->MTime.GetMTime();
 }
 
 //-----------------------------------------------------------------------------
@@ -289,15 +698,15 @@ int* vtkOffScreenRepresentationImpl::WorldToDisplay(const double point[2]) const
 }
 
 //-----------------------------------------------------------------------------
-vtkIdList* vtkOffScreenRepresentationImpl::CalculateOffScreenPoints(
+vtkIdType vtkOffScreenRepresentationImpl::CalculateOffScreenPoints(
     vtkPoints* points) const
 {
-  vtkIdList* ids = vtkIdList::New();
+  this->Internals->UpdateCoordinates(points);
 
   vtkIdType numPoints = points->GetNumberOfPoints();
   if (numPoints == 0)
   {
-    return ids;
+    return 0;
   }
 
   // Get display bounds in world coords
@@ -305,12 +714,11 @@ vtkIdList* vtkOffScreenRepresentationImpl::CalculateOffScreenPoints(
   if (displayRightTop[0] == 0 || displayRightTop[1] == 0)
   {
     // Every point is off-screen
-    ids->SetNumberOfIds(numPoints);
     for (vtkIdType i = 0; i < numPoints; ++i)
     {
-      ids->SetId(i, i);
+      this->Internals->OffScreenIds[i] = i;
     }
-    return ids;
+    return numPoints;
   }
 
   int displayLeftBottom[2] =
@@ -321,146 +729,226 @@ vtkIdList* vtkOffScreenRepresentationImpl::CalculateOffScreenPoints(
   coord = this->DisplayToWorld(displayRightTop);
   double displayBoundsInWorldRightTop[2] =
   { coord[0], coord[1] };
-  double point[3];
-
-  for (vtkIdType i = 0; i < numPoints; ++i)
-  {
-    points->GetPoint(i, point);
-    if (point[0] <= displayBoundsInWorldLeftBottom[0] ||
-        point[0] >= displayBoundsInWorldRightTop[0] ||
-        point[1] <= displayBoundsInWorldLeftBottom[1] ||
-        point[1] >= displayBoundsInWorldRightTop[1])
-    {
-      ids->InsertNextId(i);
-    }
-  }
 
-  return ids;
+  return this->Internals->Cull(displayBoundsInWorldLeftBottom,
+      displayBoundsInWorldRightTop);
 }
 
 //-----------------------------------------------------------------------------
-void vtkOffScreenRepresentationImpl::CreateRepresentation(
-    CoronaScopeProxy& proxy, vtkDataSetAttributes* inAttributes) const
+void vtkOffScreenRepresentationImpl::BuildProxyGlyphs(
+    const std::vector<CoronaScopeProxy>& proxies,
+    vtkDataSetAttributes* inAttributes, const int displayCentre[2],
+    vtkPolyData* output, vtkPolyData* instances) const
 {
-  //// Disk segment part
-  // Create new arrays, create polydata, allocate existing arrays
-  vtkDoubleArray* diskWorldPoints = vtkDoubleArray::New();
-  diskWorldPoints->SetName("world point");
-  diskWorldPoints->SetNumberOfComponents(2);
-
-  vtkIntArray* diskPolyIds = vtkIntArray::New();
-  diskPolyIds->SetName("poly id");
-
-  vtkPolyData* diskPolydata = vtkPolyData::New();
-  diskPolydata->ShallowCopy(this->ProxySource->GetOutput());
-
-  vtkDataSetAttributes* diskOutAttributes = diskPolydata->GetAttributes(
-      vtkDataSet::CELL);
-  diskOutAttributes->CopyAllocate(inAttributes);
-
-  vtkIdType numDiskPolys = diskPolydata->GetNumberOfCells();
-  diskWorldPoints->SetNumberOfTuples(numDiskPolys);
-  diskPolyIds->SetNumberOfValues(numDiskPolys);
-
-  for (vtkIdType cellId = 0; cellId < numDiskPolys; ++cellId)
+  const vtkOffScreenRepresentationImplGlyphTemplate& disk =
+      this->Internals->UpdateProxyTemplate(this->ProxySource);
+  const vtkOffScreenRepresentationImplGlyphTemplate& pointer =
+      this->Internals->UpdatePointerTemplate(this->PointerSource);
+
+  vtkIdType numProxies = static_cast<vtkIdType>(proxies.size());
+  vtkIdType diskPointCount = disk.GetNumberOfPoints();
+  vtkIdType pointsPerProxy = diskPointCount + pointer.GetNumberOfPoints();
+  vtkIdType polysPerProxy = disk.NumberOfPolys + pointer.NumberOfPolys;
+  vtkIdType stripsPerProxy = disk.NumberOfStrips + pointer.NumberOfStrips;
+  vtkIdType numPolys = numProxies * polysPerProxy;
+  vtkIdType numCells = numPolys + numProxies * stripsPerProxy;
+
+  // Allocate every output array once
+  vtkSmartPointer<vtkPoints> anchors = vtkSmartPointer<vtkPoints>::New();
+  anchors->SetNumberOfPoints(numProxies);
+  vtkSmartPointer<vtkCellArray> verts = vtkSmartPointer<vtkCellArray>::New();
+  vtkIdType* vertCells = verts->WritePointer(numProxies, 2 * numProxies);
+
+  vtkSmartPointer<vtkDoubleArray> proxyTransforms =
+      vtkSmartPointer<vtkDoubleArray>::New();
+  proxyTransforms->SetName("proxy transform");
+  proxyTransforms->SetNumberOfComponents(6);
+  proxyTransforms->SetNumberOfTuples(numProxies);
+  double* proxyTransform = proxyTransforms->GetPointer(0);
+
+  vtkSmartPointer<vtkDoubleArray> pointerTransforms =
+      vtkSmartPointer<vtkDoubleArray>::New();
+  pointerTransforms->SetName("pointer transform");
+  pointerTransforms->SetNumberOfComponents(6);
+  pointerTransforms->SetNumberOfTuples(numProxies);
+  double* pointerTransform = pointerTransforms->GetPointer(0);
+
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetNumberOfPoints(numProxies * pointsPerProxy);
+  float* xyz = static_cast<float*>(points->GetVoidPointer(0));
+
+  vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+  vtkIdType* polyCells = polys->WritePointer(numPolys,
+      numProxies * static_cast<vtkIdType>(disk.Polys.size()
+          + pointer.Polys.size()));
+  vtkSmartPointer<vtkCellArray> strips = vtkSmartPointer<vtkCellArray>::New();
+  vtkIdType* stripCells = strips->WritePointer(numCells - numPolys,
+      numProxies * static_cast<vtkIdType>(disk.Strips.size()
+          + pointer.Strips.size()));
+
+  // Proxies are scaled to fill the shortest side of the display
+  double centre[2] =
+  { static_cast<double>(displayCentre[0]),
+      static_cast<double>(displayCentre[1]) };
+  double scale = displayCentre[0] < displayCentre[1] ?
+      centre[0] : centre[1];
+  double diskHalfWidth = (this->ProxySource->GetEndAngle()
+      - this->ProxySource->GetStartAngle()) / 2.0;
+  double pointerHalfWidth = (this->PointerSource->GetEndAngle()
+      - this->PointerSource->GetStartAngle()) / 2.0;
+  bool showError = this->ReduceOverlaps && this->ShowError;
+  double worldSize = this->GetWorldSizeInUse();
+  double diskDepth = this->OuterBezelRadius - this->InnerBezelRadius;
+  double maximumDiskStretch = diskDepth > 0.0 ?
+      std::max(1.0, this->OuterBezelRadius / diskDepth) : 1.0;
+
+  for (vtkIdType i = 0; i < numProxies; ++i)
   {
-    diskOutAttributes->CopyData(inAttributes, proxy.InputPointId, cellId);
-    diskWorldPoints->SetTuple(cellId, proxy.WorldPoint);
-    diskPolyIds->SetValue(cellId, proxy.InputPointId);
+    const CoronaScopeProxy& proxy = proxies[i];
+    vtkIdType offset = i * pointsPerProxy;
+
+    // The disk segment is rotated into position about the centre. An
+    // aggregate reaches further in from the outer bezel radius the more
+    // proxies it stands for, one disk depth per power of ten.
+    double* m = proxyTransform + 6 * i;
+    double diskRotate = vtkMath::RadiansFromDegrees(
+        proxy.GetAngleInDegrees() - diskHalfWidth);
+    double diskStretch = proxy.Count > 1 ?
+        std::min(1.0 + log10(static_cast<double>(proxy.Count)),
+            maximumDiskStretch) : 1.0;
+    vtkOffScreenRepresentationImplGlyphTemplate::ComputePlacement(diskRotate,
+        0.0, diskStretch, this->OuterBezelRadius, centre, scale, m);
+    disk.Place(m, xyz + 3 * offset);
+    disk.InsertCells(offset, polyCells, stripCells);
+
+    // The pointer is stretched along x from the outer bezel radius according
+    // to the off-screen distance, rotated to show the error resulting from
+    // overlap reduction, then rotated into position
+    double pointerRotate = vtkMath::RadiansFromDegrees(
+        proxy.GetAngleInDegrees() - pointerHalfWidth);
+    double error = showError ?
+        vtkMath::RadiansFromDegrees(proxy.Error) : 0.0;
+    m = pointerTransform + 6 * i;
+    vtkOffScreenRepresentationImplGlyphTemplate::ComputePlacement(
+        pointerRotate, error, proxy.DistanceInWorld / worldSize,
+        this->OuterBezelRadius, centre, scale, m);
+    pointer.Place(m, xyz + 3 * (offset + diskPointCount));
+    pointer.InsertCells(offset + diskPointCount, polyCells, stripCells);
+
+    // The instance is anchored where the proxy meets the outer bezel
+    double angle = vtkMath::RadiansFromDegrees(proxy.GetAngleInDegrees());
+    anchors->SetPoint(i,
+        centre[0] + scale * this->OuterBezelRadius * cos(angle),
+        centre[1] + scale * this->OuterBezelRadius * sin(angle), 0.0);
+    vertCells[2 * i] = 1;
+    vertCells[2 * i + 1] = i;
   }
 
-  vtkCellData* diskCellData = diskPolydata->GetCellData();
-  diskCellData->AddArray(diskWorldPoints);
-  diskCellData->AddArray(diskPolyIds);
-
-  // Transform into position
-  double diskRotate = proxy.GetAngleInDegrees()
-          - ((this->ProxySource->GetEndAngle() - this->ProxySource->GetStartAngle())
-              / 2.0);
-  this->ProxySourceTransform->Identity();
-  this->ProxySourceTransform->RotateZ(diskRotate);
-
-  vtkPoints* diskTransformedPoints = vtkPoints::New();
-  this->ProxySourceTransform->TransformPoints(diskPolydata->GetPoints(),
-      diskTransformedPoints);
-  diskPolydata->SetPoints(diskTransformedPoints);
-
-  diskWorldPoints->Delete();
-  diskPolyIds->Delete();
-  diskTransformedPoints->Delete();
-
-  //// Pointer part
-  // Create new arrays, create polydata, allocate existing arrays
-  vtkDoubleArray* pointerWorldPoints = vtkDoubleArray::New();
-  pointerWorldPoints->SetName("world point");
-  pointerWorldPoints->SetNumberOfComponents(2);
-
-  vtkIntArray* pointerPolyIds = vtkIntArray::New();
-  pointerPolyIds->SetName("poly id");
-
-  vtkPolyData* pointerPolydata = vtkPolyData::New();
-  pointerPolydata->ShallowCopy(this->PointerSource->GetOutput());
-
-  vtkDataSetAttributes* pointerOutAttributes = pointerPolydata->GetAttributes(
+  // Cell attributes: polys come before strips in the cell ids of polydata
+  vtkDataSetAttributes* outAttributes = output->GetAttributes(
       vtkDataSet::CELL);
-  pointerOutAttributes->CopyAllocate(inAttributes);
-
-  vtkIdType numPointerPolys = pointerPolydata->GetNumberOfCells();
-  pointerWorldPoints->SetNumberOfTuples(numPointerPolys);
-  pointerPolyIds->SetNumberOfValues(numPointerPolys);
-
-  for (vtkIdType cellId = 0; cellId < numPointerPolys; ++cellId)
+  outAttributes->CopyAllocate(inAttributes, numCells);
+
+  vtkSmartPointer<vtkDoubleArray> worldPoints =
+      vtkSmartPointer<vtkDoubleArray>::New();
+  worldPoints->SetName("world point");
+  worldPoints->SetNumberOfComponents(2);
+  worldPoints->SetNumberOfTuples(numCells);
+  double* worldPoint = worldPoints->GetPointer(0);
+
+  vtkSmartPointer<vtkIntArray> polyIds = vtkSmartPointer<vtkIntArray>::New();
+  polyIds->SetName("poly id");
+  polyIds->SetNumberOfValues(numCells);
+  int* polyId = polyIds->GetPointer(0);
+
+  vtkSmartPointer<vtkIntArray> counts = vtkSmartPointer<vtkIntArray>::New();
+  counts->SetName("proxy count");
+  counts->SetNumberOfValues(numCells);
+  int* count = counts->GetPointer(0);
+
+  vtkSmartPointer<vtkIntArray> bins = vtkSmartPointer<vtkIntArray>::New();
+  bins->SetName("aggregate bin");
+  bins->SetNumberOfValues(numCells);
+  int* bin = bins->GetPointer(0);
+
+  for (vtkIdType i = 0; i < numProxies; ++i)
   {
-    pointerOutAttributes->CopyData(inAttributes, proxy.InputPointId, cellId);
-    pointerWorldPoints->SetTuple(cellId, proxy.WorldPoint);
-    pointerPolyIds->SetValue(cellId, proxy.InputPointId);
+    const CoronaScopeProxy& proxy = proxies[i];
+    vtkIdType cellId = i * polysPerProxy;
+    for (vtkIdType j = 0; j < polysPerProxy + stripsPerProxy; ++j, ++cellId)
+    {
+      if (j == polysPerProxy)
+      {
+        cellId = numPolys + i * stripsPerProxy;
+      }
+      outAttributes->CopyData(inAttributes, proxy.InputPointId, cellId);
+      worldPoint[2 * cellId] = proxy.WorldPoint[0];
+      worldPoint[2 * cellId + 1] = proxy.WorldPoint[1];
+      polyId[cellId] = static_cast<int>(proxy.InputPointId);
+      count[cellId] = proxy.Count;
+      bin[cellId] = proxy.Bin;
+    }
   }
 
-  vtkCellData* pointerCellData = pointerPolydata->GetCellData();
-  pointerCellData->AddArray(pointerWorldPoints);
-  pointerCellData->AddArray(pointerPolyIds);
-
-  // Transform into position
-  double pointerRotate = proxy.GetAngleInDegrees()
-          - ((this->PointerSource->GetEndAngle()
-              - this->PointerSource->GetStartAngle()) / 2.0);
-
-  this->PointerSourceTransform->Identity();
-  this->PointerSourceTransform->RotateZ(pointerRotate);
-  this->PointerSourceTransform->Translate(this->OuterBezelRadius, 0.0, 0.0);
-
-  // Scale pointer according to off-screen distance
-  this->PointerSourceTransform->Scale(proxy.DistanceInWorld / this->WorldSize,
-      1.0, 1.0);
-
-  // Rotate to show error resulting from overlap reduction
-  if (this->ReduceOverlaps && this->ShowError)
+  output->SetPoints(points);
+  output->SetPolys(polys);
+  output->SetStrips(strips);
+  output->GetCellData()->AddArray(worldPoints);
+  output->GetCellData()->AddArray(polyIds);
+  output->GetCellData()->AddArray(counts);
+  output->GetCellData()->AddArray(bins);
+
+  // Point attributes of the instances, one point per proxy
+  vtkDataSetAttributes* instanceAttributes = instances->GetAttributes(
+      vtkDataSet::POINT);
+  instanceAttributes->CopyAllocate(inAttributes, numProxies);
+
+  vtkSmartPointer<vtkDoubleArray> instanceWorldPoints =
+      vtkSmartPointer<vtkDoubleArray>::New();
+  instanceWorldPoints->SetName("world point");
+  instanceWorldPoints->SetNumberOfComponents(2);
+  instanceWorldPoints->SetNumberOfTuples(numProxies);
+
+  vtkSmartPointer<vtkIntArray> instancePolyIds =
+      vtkSmartPointer<vtkIntArray>::New();
+  instancePolyIds->SetName("poly id");
+  instancePolyIds->SetNumberOfValues(numProxies);
+
+  vtkSmartPointer<vtkIntArray> instanceCounts =
+      vtkSmartPointer<vtkIntArray>::New();
+  instanceCounts->SetName("proxy count");
+  instanceCounts->SetNumberOfValues(numProxies);
+
+  vtkSmartPointer<vtkIntArray> instanceBins =
+      vtkSmartPointer<vtkIntArray>::New();
+  instanceBins->SetName("aggregate bin");
+  instanceBins->SetNumberOfValues(numProxies);
+
+  vtkSmartPointer<vtkDoubleArray> instanceErrors =
+      vtkSmartPointer<vtkDoubleArray>::New();
+  instanceErrors->SetName("proxy error");
+  instanceErrors->SetNumberOfValues(numProxies);
+
+  for (vtkIdType i = 0; i < numProxies; ++i)
   {
-    this->PointerSourceTransform->RotateZ(proxy.Error);
+    const CoronaScopeProxy& proxy = proxies[i];
+    instanceAttributes->CopyData(inAttributes, proxy.InputPointId, i);
+    instanceWorldPoints->SetTupleValue(i, proxy.WorldPoint);
+    instancePolyIds->SetValue(i, static_cast<int>(proxy.InputPointId));
+    instanceCounts->SetValue(i, proxy.Count);
+    instanceBins->SetValue(i, proxy.Bin);
+    instanceErrors->SetValue(i, proxy.Error);
   }
-  this->PointerSourceTransform->Translate(-this->OuterBezelRadius, 0.0, 0.0);
-
-  vtkPoints* pointerTransformedPoints = vtkPoints::New();
-  this->PointerSourceTransform->TransformPoints(pointerPolydata->GetPoints(),
-      pointerTransformedPoints);
-  pointerPolydata->SetPoints(pointerTransformedPoints);
-
-  pointerWorldPoints->Delete();
-  pointerPolyIds->Delete();
-  pointerTransformedPoints->Delete();
-
-  //// Join the parts and add the final representation to the proxy.
-  this->PointerAppend->RemoveAllInputs();
-  this->PointerAppend->AddInput(diskPolydata);
-  this->PointerAppend->AddInput(pointerPolydata);
-  this->PointerAppend->Update();
-  vtkSmartPointer<vtkPolyData> representation =
-      vtkSmartPointer<vtkPolyData>::New();
-  representation->ShallowCopy(this->PointerAppend->GetOutput());
-  proxy.Representation = representation;
 
-  diskPolydata->Delete();
-  pointerPolydata->Delete();
+  instances->SetPoints(anchors);
+  instances->SetVerts(verts);
+  instances->GetPointData()->AddArray(proxyTransforms);
+  instances->GetPointData()->AddArray(pointerTransforms);
+  instances->GetPointData()->AddArray(instanceWorldPoints);
+  instances->GetPointData()->AddArray(instancePolyIds);
+  instances->GetPointData()->AddArray(instanceCounts);
+  instances->GetPointData()->AddArray(instanceBins);
+  instances->GetPointData()->AddArray(instanceErrors);
 }
 
 //-----------------------------------------------------------------------------
@@ -482,74 +970,196 @@ void vtkOffScreenRepresentationImpl::OverlapReduction(
           - this->ProxySource->GetStartAngle();
   double spacing = width * 0.1;
 
-  //// Initialize segments: one proxy per segment
-  std::vector<CoronaScopeSegment> segments;
+  //// Keep the original angles: segments refer to proxies by index
+  std::vector<double> angles(numberOfProxies);
   for (size_t i = 0; i < numberOfProxies; ++i)
   {
-    CoronaScopeSegment s(spacing, width);
-    s.proxies.push_back(&proxies[i]);
-    segments.push_back(s);
+    angles[i] = proxies[i].GetAngleInDegrees();
   }
 
-  //// Merge overlapping segments
-  size_t lastCount = 0;
-  do
+  //// Sweep anticlockwise, one proxy per new segment. Each new segment is
+  //// merged with the segments before it for as long as they overlap, so the
+  //// stack always holds disjoint segments in order.
+  std::vector<CoronaScopeSegment> segments;
+  segments.reserve(numberOfProxies);
+  for (size_t i = 0; i < numberOfProxies; ++i)
   {
-    std::vector<CoronaScopeSegment> merged;
-    std::vector<CoronaScopeSegment>::iterator previous = segments.begin();
-    std::vector<CoronaScopeSegment>::iterator current = segments.begin() + 1;
-    for (; current != segments.end(); ++current)
+    segments.push_back(
+        CoronaScopeSegment(i, i + 1, angles[i], spacing, width));
+    while (segments.size() > 1
+        && segments[segments.size() - 2].Overlaps(segments.back()))
     {
-      if (previous->GetExpandedForwardExtent()
-          > current->GetExpandedReverseExtent())
-      {
-        current->proxies.insert(current->proxies.end(),
-            previous->proxies.begin(), previous->proxies.end());
-      }
-      else
-      {
-        merged.push_back(*previous);
-      }
-      previous = current;
+      CoronaScopeSegment merged = CoronaScopeMergeSegments(angles,
+          segments[segments.size() - 2], segments.back());
+      segments.pop_back();
+      segments.back() = merged;
     }
-    merged.push_back(*previous);
-
+  }
 
-    // CSM_TODO Here lurks a bug.
-    //// Check the end-case where the last segment (up to 360 degrees) could
-    //// overlap with the first (from 0 degrees). We rely on the fact that
-    //// segments->GetExpandedReverseExtent() can return a negative angle.
-    current = merged.begin();
-    if (current->GetExpandedReverseExtent() < 0.0
-        && previous->GetExpandedForwardExtent()
-        > current->GetExpandedReverseExtent())
+  //// Close the circle: while the last segment overlaps the first (one turn
+  //// further round), absorb the first into the last. The grown segment may
+  //// then reach back over its predecessors, which are merged as above.
+  size_t first = 0;
+  while (segments.size() - first > 1)
+  {
+    const CoronaScopeSegment& front = segments[first];
+    CoronaScopeSegment wrapped(front.Begin + numberOfProxies,
+        front.End + numberOfProxies, front.Centre + 360.0, spacing, width);
+    if (!segments.back().Overlaps(wrapped))
     {
-      current->proxies.insert(current->proxies.begin(),
-          previous->proxies.begin(), previous->proxies.end());
-      merged.pop_back();
+      break;
     }
+    segments.back() = CoronaScopeMergeSegments(angles, segments.back(),
+        wrapped);
+    ++first;
 
-    lastCount = segments.size();
-    segments = merged;
-  } while (segments.size() > 1 && lastCount != segments.size());
+    while (segments.size() - first > 1
+        && segments[segments.size() - 2].Overlaps(segments.back()))
+    {
+      CoronaScopeSegment merged = CoronaScopeMergeSegments(angles,
+          segments[segments.size() - 2], segments.back());
+      segments.pop_back();
+      segments.back() = merged;
+    }
+  }
 
-  //// Distribute proxies within each segment
+  //// Distribute proxies within each segment, keeping their order
   double separation = (spacing + width);
-  std::vector<CoronaScopeSegment>::iterator segment = segments.begin();
-  for (; segment != segments.end(); ++segment)
+  for (size_t s = first; s < segments.size(); ++s)
   {
-    double angle = segment->GetExpandedReverseExtent() + separation / 2.0;
-    for (size_t i = 0; i < segment->proxies.size(); ++i)
+    const CoronaScopeSegment& segment = segments[s];
+    double angle = segment.GetExpandedReverseExtent() + separation / 2.0;
+    for (size_t i = segment.Begin; i < segment.End; ++i)
     {
       // Calculate the error and store with the proxy info
-      segment->proxies[i]->Error = segment->proxies[i]->GetAngleInDegrees()
-              - angle;
-      segment->proxies[i]->SetAngleInDegrees(angle);
+      CoronaScopeProxy& proxy = proxies[i % numberOfProxies];
+      proxy.Error = CoronaScopeUnwrappedAngle(angles, i) - angle;
+      proxy.SetAngleInDegrees(angle);
       angle += separation;
     }
   }
 }
 
+//-----------------------------------------------------------------------------
+void vtkOffScreenRepresentationImpl::ClusterProxies(
+    std::vector<CoronaScopeProxy>& proxies,
+    vtkDataSetAttributes* inAttributes) const
+{
+  size_t numberOfProxies = proxies.size();
+  if (numberOfProxies == 0)
+  {
+    return;
+  }
+
+  //// The colours the proxies of a bin are told apart by
+  vtkUnsignedCharArray* colors = vtkUnsignedCharArray::SafeDownCast(
+      inAttributes->GetAbstractArray("Hull color"));
+  int numComponents = colors ? colors->GetNumberOfComponents() : 0;
+  if (numComponents > 4)
+  {
+    numComponents = 4;
+  }
+
+  //// Bucket the proxies by bin with a counting sort, so the cost is linear
+  //// in the number of proxies plus the number of bins
+  double binWidth = 360.0 / this->NumberOfAggregationBins;
+  double distanceScale =
+      this->NumberOfDistanceBins / this->GetWorldSizeInUse();
+  int numBins = this->NumberOfAggregationBins * this->NumberOfDistanceBins;
+  std::vector<int> proxyBins(numberOfProxies);
+  std::vector<size_t> binStart(numBins + 1, 0);
+  for (size_t i = 0; i < numberOfProxies; ++i)
+  {
+    const CoronaScopeProxy& proxy = proxies[i];
+    int angleBin = static_cast<int>(proxy.GetAngleInDegrees() / binWidth);
+    angleBin = std::min(angleBin, this->NumberOfAggregationBins - 1);
+    int distanceBin = static_cast<int>(proxy.DistanceInWorld * distanceScale);
+    distanceBin = std::min(distanceBin, this->NumberOfDistanceBins - 1);
+    proxyBins[i] = angleBin * this->NumberOfDistanceBins + distanceBin;
+    ++binStart[proxyBins[i] + 1];
+  }
+  for (int bin = 0; bin < numBins; ++bin)
+  {
+    binStart[bin + 1] += binStart[bin];
+  }
+
+  //// Key each proxy by its (packed) colour in its bin's range
+  std::vector<size_t> binFill(binStart.begin(), binStart.end() - 1);
+  std::vector<CoronaScopeBinKey> keys(numberOfProxies);
+  for (size_t i = 0; i < numberOfProxies; ++i)
+  {
+    CoronaScopeBinKey& key = keys[binFill[proxyBins[i]]++];
+    key.Bin = proxyBins[i];
+    key.Colour = 0;
+    for (int c = 0; c < numComponents; ++c)
+    {
+      key.Colour = (key.Colour << 8)
+          | colors->GetValue(proxies[i].InputPointId
+              * colors->GetNumberOfComponents() + c);
+    }
+    key.Distance = proxies[i].DistanceInWorld;
+    key.Index = i;
+  }
+
+  //// Replace each bin by one proxy, unless it is the expanded bin. Only the
+  //// proxies of a bin are sorted, to find its dominant colour.
+  std::vector<CoronaScopeProxy> clustered;
+  clustered.reserve(std::min(numberOfProxies, static_cast<size_t>(numBins)));
+  for (int bin = 0; bin < numBins; ++bin)
+  {
+    size_t begin = binStart[bin];
+    size_t end = binStart[bin + 1];
+    if (begin == end)
+    {
+      continue;
+    }
+    std::sort(keys.begin() + begin, keys.begin() + end);
+
+    if (end - begin == 1 || bin == this->ExpandedProxyBin)
+    {
+      for (size_t k = begin; k < end; ++k)
+      {
+        clustered.push_back(proxies[keys[k].Index]);
+        clustered.back().Bin = bin;
+      }
+      continue;
+    }
+
+    // The dominant colour is the longest colour run; its nearest proxy
+    // represents the bin
+    size_t representative = begin;
+    size_t longestRun = 0;
+    double sumAngle = 0.0;
+    double sumDistance = 0.0;
+    size_t run = begin;
+    for (size_t k = begin; k < end; ++k)
+    {
+      if (keys[k].Colour != keys[run].Colour)
+      {
+        run = k;
+      }
+      if (k - run + 1 > longestRun)
+      {
+        longestRun = k - run + 1;
+        representative = run;
+      }
+      sumAngle += proxies[keys[k].Index].GetAngleInDegrees();
+      sumDistance += keys[k].Distance;
+    }
+
+    CoronaScopeProxy aggregate = proxies[keys[representative].Index];
+    double count = static_cast<double>(end - begin);
+    aggregate.SetAngleInDegrees(sumAngle / count);
+    aggregate.DistanceInWorld = sumDistance / count;
+    aggregate.Error = 0.0;
+    aggregate.Count = static_cast<int>(end - begin);
+    aggregate.Bin = bin;
+    clustered.push_back(aggregate);
+  }
+
+  proxies.swap(clustered);
+}
+
 //-----------------------------------------------------------------------------
 void vtkOffScreenRepresentationImpl::SetInnerBezelRadius(double r)
 {
@@ -580,6 +1190,25 @@ double vtkOffScreenRepresentationImpl::GetOuterBezelRadius()
   return this->OuterBezelRadius;
 }
 
+//-----------------------------------------------------------------------------
+double vtkOffScreenRepresentationImpl::GetWorldSizeInUse() const
+{
+  return this->WorldSize > 0.0 ?
+      this->WorldSize : this->Internals->EstimatedWorldSize;
+}
+
+//-----------------------------------------------------------------------------
+vtkPolyData* vtkOffScreenRepresentationImpl::GetProxyTemplate()
+{
+  return this->Internals->UpdateProxyTemplate(this->ProxySource).Shape;
+}
+
+//-----------------------------------------------------------------------------
+vtkPolyData* vtkOffScreenRepresentationImpl::GetPointerTemplate()
+{
+  return this->Internals->UpdatePointerTemplate(this->PointerSource).Shape;
+}
+
 //-----------------------------------------------------------------------------
 int vtkOffScreenRepresentationImpl::RequestData(
     vtkInformation *vtkNotUsed(request), vtkInformationVector **inputVector,
@@ -596,6 +1225,7 @@ int vtkOffScreenRepresentationImpl::RequestData(
   vtkInformation *inInfo = inputVector[0]->GetInformationObject(0);
   vtkInformation *outInfo = outputVector->GetInformationObject(0);
   vtkInformation *outInfo1 = outputVector->GetInformationObject(1);
+  vtkInformation *outInfo2 = outputVector->GetInformationObject(2);
 
   vtkPolyData *input = vtkPolyData::SafeDownCast(
       inInfo->Get(vtkDataObject::DATA_OBJECT()));
@@ -606,6 +1236,9 @@ int vtkOffScreenRepresentationImpl::RequestData(
   vtkPolyData *output1 = vtkPolyData::SafeDownCast(
       outInfo1->Get(vtkDataObject::DATA_OBJECT()));
 
+  vtkPolyData *output2 = vtkPolyData::SafeDownCast(
+      outInfo2->Get(vtkDataObject::DATA_OBJECT()));
+
   /* First, add the bezel and centre-spot
    *
    */
@@ -616,6 +1249,7 @@ int vtkOffScreenRepresentationImpl::RequestData(
     vtkWarningMacro(<< "Zero size window");
     return 1;
   }
+
   int displayCentre[2] =
   { displayRightTop[0] / 2, displayRightTop[1] / 2 };
   double* coord = this->DisplayToWorld(displayCentre);
@@ -657,31 +1291,26 @@ int vtkOffScreenRepresentationImpl::RequestData(
     return 1;
   }
 
-  // Estimate world size from input if not set explicitly
-  if (this->WorldSize <= 0)
-  {
-    double* bb = input->GetBounds();
-    this->WorldSize = sqrt(
-        (bb[1] - bb[0] * bb[1] - bb[0]) + (bb[3] - bb[2] * bb[3] - bb[2]));
-  }
-
   // Determine direction and distance to each offscreen point
   std::vector<CoronaScopeProxy> offScreenProxies;
-  double inPoint[3];
+  double inPoint[2];
   double trPoint[2];
   double angle;
   double distance;
   CoronaScopeProxy offScreenProxy;
 
   // First, get a list of points that are off screen
-  vtkIdList* offScreenIds = this->CalculateOffScreenPoints(inPoints);
-  vtkIdType numOffScreenPoints = offScreenIds->GetNumberOfIds();
+  vtkIdType numOffScreenPoints = this->CalculateOffScreenPoints(inPoints);
+  const vtkIdType* offScreenIds = numOffScreenPoints > 0 ?
+      &this->Internals->OffScreenIds[0] : 0;
 
   // Second, build a list of 'proxy' objects
+  offScreenProxies.reserve(numOffScreenPoints);
   for (vtkIdType i = 0; i < numOffScreenPoints; ++i)
   {
-    vtkIdType j = offScreenIds->GetId(i);
-    inPoints->GetPoint(j, inPoint);
+    vtkIdType j = offScreenIds[i];
+    inPoint[0] = this->Internals->X[j];
+    inPoint[1] = this->Internals->Y[j];
     trPoint[0] = inPoint[0] - displayCentreInWorld[0];
     trPoint[1] = inPoint[1] - displayCentreInWorld[1];
 
@@ -694,9 +1323,17 @@ int vtkOffScreenRepresentationImpl::RequestData(
     offScreenProxy.WorldPoint[0] = inPoint[0];
     offScreenProxy.WorldPoint[1] = inPoint[1];
     offScreenProxy.Error = 0.0;
+    offScreenProxy.Count = 1;
+    offScreenProxy.Bin = -1;
     offScreenProxies.push_back(offScreenProxy);
   }
-  offScreenIds->Delete();
+
+  // Third, optionally collapse the proxies sharing a bin into one
+  if (this->AggregateProxies)
+  {
+    this->ClusterProxies(offScreenProxies,
+        input->GetAttributes(vtkDataSet::POINT));
+  }
 
   /* PART B: Overlap reduction
    * IN:
@@ -716,49 +1353,25 @@ int vtkOffScreenRepresentationImpl::RequestData(
    *    distance to offscreen points (world coordinates)
    *    attributes of related input points
    * OUT:
-   *    list of proxy representations
+   *    proxy glyphs in display coordinates
+   *    one instance per proxy with the placement of each glyph part
    */
 
   // Get attributes from input
   vtkDataSetAttributes* inAttributes = input->GetAttributes(vtkDataSet::POINT);
-  size_t numOffScreenProxies = offScreenProxies.size();
 
-  // Glyph each point
-  for (size_t i = 0; i < numOffScreenProxies; ++i)
+  // Glyph every proxy straight into the output
+  output->Initialize();
+  output2->Initialize();
+  if (offScreenProxies.empty())
   {
-    this->CreateRepresentation(offScreenProxies.at(i), inAttributes);
-  }
-
-  /* PART D: Append the proxy representation polydatas into the output
-   *
-   */
-  this->ProxyAppend->RemoveAllInputs();
-  if (numOffScreenProxies == 0)
-  {
-    this->ProxyAppend->AddInput(this->EmptyPolyData);
-    this->ProxyAppend->Update();
-    output->ShallowCopy(this->ProxyAppend->GetOutput());
+    output->ShallowCopy(this->EmptyPolyData);
+    output2->ShallowCopy(this->EmptyPolyData);
   }
   else
   {
-    for (size_t i = 0; i < numOffScreenProxies; ++i)
-    {
-      this->ProxyAppend->AddInput(offScreenProxies.at(i).Representation);
-    }
-    this->ProxyTransform->Identity();
-    this->ProxyTransform->Translate(displayCentre[0], displayCentre[1], 0.0);
-    if (displayCentre[0] < displayCentre[1])
-    {
-      this->ProxyTransform->Scale(displayCentre[0], displayCentre[0], 1.0);
-      this->ProxyTransformFilter->Update();
-      output->ShallowCopy(this->ProxyTransformFilter->GetOutput());
-    }
-    else
-    {
-      this->ProxyTransform->Scale(displayCentre[1], displayCentre[1], 1.0);
-      this->ProxyTransformFilter->Update();
-      output->ShallowCopy(this->ProxyTransformFilter->GetOutput());
-    }
+    this->BuildProxyGlyphs(offScreenProxies, inAttributes, displayCentre,
+        output, output2);
   }
 
   return 1;
@@ -781,4 +1394,15 @@ void vtkOffScreenRepresentationImpl::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "ReduceOverlaps: " << (this->ReduceOverlaps ? "On" : "Off")
           << endl;
   os << indent << "ShowError: " << (this->ShowError ? "On" : "Off") << endl;
+  os << indent << "AggregateProxies: "
+      << (this->AggregateProxies ? "On" : "Off") << endl;
+  os << indent << "NumberOfAggregationBins: "
+      << this->NumberOfAggregationBins << endl;
+  os << indent << "NumberOfDistanceBins: " << this->NumberOfDistanceBins
+      << endl;
+  os << indent << "ExpandedProxyBin: " << this->ExpandedProxyBin << endl;
+  os << indent << "NumberOfViewCacheHits: " << this->NumberOfViewCacheHits
+      << endl;
+  os << indent << "NumberOfViewCacheMisses: "
+      << this->NumberOfViewCacheMisses << endl;
 }
@@ -27,7 +27,8 @@
 // Each proxy has a <i>pointer</i>, an arrow-like feature that grows as the
 // distance from the centre of the screen to the target increases during a pan
 // operation (zoom does not affect the distance since it is calculated in world
-// coordinates). To facilitate this it is necessary to call SetWorldSize().
+// coordinates). Its length is the distance relative to the world size, which
+// is either set with SetWorldSize() or estimated from the input points.
 //
 // The design here makes use of opacity to enable the creation of 'visual levels'.
 // This leads to visual clutter when proxies overlap so an algorithm to remove
@@ -36,6 +37,16 @@
 // original order around the bezel. This introduces an error which can be
 // visualized by selecting ShowErrorOn().
 //
+// Output port 0 holds the proxy glyphs in display coordinates and port 1 the
+// bezel and centre spot. Port 2 describes the same proxies as instances of
+// the proxy and pointer templates (see GetProxyTemplate()): one vertex per
+// proxy carrying the "proxy transform" and "pointer transform" point arrays,
+// each a row-major 2x3 affine matrix that places the template in display
+// coordinates, together with the attributes copied from the input point.
+// Its "proxy error" array holds the angle (in degrees) that overlap
+// reduction moved each proxy by, clockwise positive. vtkOffScreenProxyMapper2D
+// draws this output.
+//
 // .SEE ALSO
 // vtkOffScreenRepresentation vtkOffScreenWidget
 
@@ -49,6 +60,10 @@
 // Private class used to manage various proxy attributes.
 struct CoronaScopeProxy;
 
+// Private class holding the coordinate and id buffers and the outputs reused
+// between executions.
+class vtkOffScreenRepresentationImplInternals;
+
 class vtkAppendPolyData;
 class vtkCoordinate;
 class vtkDataSetAttributes;
@@ -72,7 +87,9 @@ public:
   void SetRenderer(vtkRenderer* renderer);
 
   // Description:
-  // Synchronize the modified time with the renderer to respond to window changes.
+  // Synchronize the modified time with the view of the renderer: its
+  // display size and display bounds in world coordinates. Changes to the
+  // renderer that leave the view as it was do not cause an execution.
   virtual unsigned long GetMTime();
 
   // Description:
@@ -107,12 +124,52 @@ public:
   vtkGetMacro(ShowError, bool)
   vtkBooleanMacro(ShowError, bool)
 
+  // Description:
+  // When on, the proxies that fall in the same angular bin (of
+  // NumberOfAggregationBins around the bezel) and the same distance band (of
+  // NumberOfDistanceBins up to the world size) are collapsed into a single
+  // proxy. It points at the mean angle and distance of the bin and takes its
+  // attributes from the nearest proxy of the most frequent "Hull color". The
+  // number of proxies it stands for and its bin are given by the "proxy
+  // count" and "aggregate bin" arrays of the output. An aggregate's disk
+  // reaches in from the outer bezel radius by one more disk depth for every
+  // power of ten proxies it stands for. Proxies are bucketed by bin and only
+  // sorted within a bin, and the number of glyphs is bounded by the number
+  // of bins, whatever the number of landmarks. Default off.
+  vtkSetMacro(AggregateProxies, bool)
+  vtkGetMacro(AggregateProxies, bool)
+  vtkBooleanMacro(AggregateProxies, bool)
+  vtkSetClampMacro(NumberOfAggregationBins, int, 1, 3600)
+  vtkGetMacro(NumberOfAggregationBins, int)
+  vtkSetClampMacro(NumberOfDistanceBins, int, 1, 100)
+  vtkGetMacro(NumberOfDistanceBins, int)
+
+  // Description:
+  // The bin whose proxies are shown individually when aggregating, or -1
+  // (the default) for none.
+  vtkSetMacro(ExpandedProxyBin, int)
+  vtkGetMacro(ExpandedProxyBin, int)
+
+  // Description:
+  // The unplaced proxy and pointer shapes that the instances on output port
+  // 2 refer to.
+  vtkPolyData* GetProxyTemplate();
+  vtkPolyData* GetPointerTemplate();
+
   // Description:
   // Explicitly set the world size used to calculate pointer lengths. If 0
-  // (the default), the size is calculated from the bounding box of the input.
+  // (the default), the size is the diagonal of the bounding box of the input
+  // points, recomputed only when they are modified.
   vtkSetMacro(WorldSize, double)
   vtkGetMacro(WorldSize, double)
 
+  // Description:
+  // The renderer is modified by much more than camera moves. These count
+  // the changes to the renderer that left the view as it was, so caused no
+  // execution (hits), and the changes to the view (misses).
+  vtkGetMacro(NumberOfViewCacheHits, unsigned long)
+  vtkGetMacro(NumberOfViewCacheMisses, unsigned long)
+
 protected:
   vtkOffScreenRepresentationImpl();
   ~vtkOffScreenRepresentationImpl();
@@ -128,12 +185,21 @@ protected:
   int* WorldToDisplay(const double point[2]) const;
 
   // Description:
-  // Calculate which points are off-screen. Returns a list of ids.
-  vtkIdList* CalculateOffScreenPoints(vtkPoints* points) const;
+  // Calculate which points are off-screen. The ids are written to the id
+  // buffer of the internals, which is reused between executions, and their
+  // number is returned.
+  vtkIdType CalculateOffScreenPoints(vtkPoints* points) const;
 
   // Description:
-  // Build the polydata that make up the proxies.
-  void CreateRepresentation(CoronaScopeProxy& proxy,
+  // Build the polydata that make up the proxies, placed around the bezel
+  // centred on displayCentre, and the matching instances.
+  void BuildProxyGlyphs(const std::vector<CoronaScopeProxy>& proxies,
+      vtkDataSetAttributes* inAttributes, const int displayCentre[2],
+      vtkPolyData* output, vtkPolyData* instances) const;
+
+  // Description:
+  // Collapse the proxies sharing a bin into one proxy per bin.
+  void ClusterProxies(std::vector<CoronaScopeProxy>& proxies,
       vtkDataSetAttributes* inAttributes) const;
 
   // Description:
@@ -141,6 +207,10 @@ protected:
   // maintaining the original ordering.
   void OverlapReduction(std::vector<CoronaScopeProxy>& proxies) const;
 
+  // Description:
+  // The world size set explicitly or else the one estimated from the input.
+  double GetWorldSizeInUse() const;
+
 private:
   vtkOffScreenRepresentationImpl(const vtkOffScreenRepresentationImpl&); // Not implemented.
   void operator=(const vtkOffScreenRepresentationImpl&);  // Not implemented.
@@ -153,6 +223,12 @@ private:
   unsigned Resolution;
   bool ReduceOverlaps;
   bool ShowError;
+  bool AggregateProxies;
+  int NumberOfAggregationBins;
+  int NumberOfDistanceBins;
+  int ExpandedProxyBin;
+  unsigned long NumberOfViewCacheHits;
+  unsigned long NumberOfViewCacheMisses;
 
   vtkSmartPointer<vtkCoordinate> Coordinate;
   vtkSmartPointer<vtkPolyData> EmptyPolyData;
@@ -164,14 +240,9 @@ private:
   vtkSmartPointer<vtkAppendPolyData> BezelAppend;
 
   vtkSmartPointer<vtkSectorSource> ProxySource;
-  vtkSmartPointer<vtkTransform> ProxySourceTransform;
   vtkSmartPointer<vtkSectorSource> PointerSource;
-  vtkSmartPointer<vtkTransform> PointerSourceTransform;
-  vtkSmartPointer<vtkAppendPolyData> PointerAppend;
 
-  vtkSmartPointer<vtkTransform> ProxyTransform;
-  vtkSmartPointer<vtkTransformFilter> ProxyTransformFilter;
-  vtkSmartPointer<vtkAppendPolyData> ProxyAppend;
+  vtkOffScreenRepresentationImplInternals* Internals;
 };
 
 #endif // __vtkOffScreenRepresentationImpl_h
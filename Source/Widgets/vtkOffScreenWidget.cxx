@@ -20,19 +20,22 @@
 #include "vtkCamera.h"
 #include "vtkCellArray.h"
 #include "vtkCellData.h"
-#include "vtkCellLocator.h"
+#include "vtkCellType.h"
 #include "vtkCommand.h"
 #include "vtkDoubleArray.h"
 #include "vtkEvent.h"
 #include "vtkFlightMapFilter.h"
+#include "vtkFlightMapRouter.h"
+#include "vtkGraph.h"
 #include "vtkIdList.h"
 #include "vtkIdTypeArray.h"
-#include "vtkKdTree.h"
+#include "vtkIntArray.h"
 #include "vtkKochanekSpline.h"
 #include "vtkMath.h"
+#include "vtkMultiThreader.h"
+#include "vtkMutexLock.h"
 #include "vtkObjectFactory.h"
 #include "vtkOffScreenRepresentation.h"
-#include "vtkOutEdgeIterator.h"
 #include "vtkPoints.h"
 #include "vtkPolyData.h"
 #include "vtkProp.h"
@@ -43,95 +46,1069 @@
 #include "vtkRenderWindowInteractor.h"
 #include "vtkStdString.h"
 #include "vtkStringArray.h"
+#include "vtkTimerLog.h"
 #include "vtkTupleInterpolator.h"
 #include "vtkWidgetCallbackMapper.h"
 #include "vtkWidgetEvent.h"
 #include "vtkWidgetEventTranslator.h"
 
+#include <vtksys/ios/sstream>
+
 #include <algorithm>
-#include <deque>
 #include <map>
+#include <vector>
+
+
+//-------------------------------------------------------------------------
+// Description:
+// A camera keyframe, held in single precision to keep long histories small.
+struct FlightKeyframe
+{
+  float FocalPoint[3];
+  float ParallelScale;
+  float ViewUp[3];
+
+  //-------------------------------------------------------------------------
+  void Set(const double focalPoint[3], double parallelScale,
+      const double viewUp[3])
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      this->FocalPoint[i] = static_cast<float>(focalPoint[i]);
+      this->ViewUp[i] = static_cast<float>(viewUp[i]);
+    }
+    this->ParallelScale = static_cast<float>(parallelScale);
+  }
+
+  //-------------------------------------------------------------------------
+  bool SameView(const FlightKeyframe& other) const
+  {
+    return this->FocalPoint[0] == other.FocalPoint[0]
+        && this->FocalPoint[1] == other.FocalPoint[1]
+        && this->ParallelScale == other.ParallelScale;
+  }
+};
+
+//-------------------------------------------------------------------------
+// Description:
+// A stop in the flight history, with a few keyframes of the camera path
+// from the previous stop. The last keyframe is the stop itself. The camera
+// path through the keyframes is compiled when the stop is recorded, so
+// replaying it only needs the table.
+struct FlightHistoryEntry
+{
+  enum
+  {
+    NumberOfKeyframes = 8
+  };
+  FlightKeyframe Path[NumberOfKeyframes];
+  std::vector<double> Table;
+
+  //-------------------------------------------------------------------------
+  const FlightKeyframe& GetStop() const
+  {
+    return this->Path[NumberOfKeyframes - 1];
+  }
+};
+
+//-------------------------------------------------------------------------
+// Description:
+// A fixed-capacity ring buffer of flight history entries with a cursor on
+// the current stop. Recording after going back discards the stops ahead of
+// the cursor, and once full the oldest stop is overwritten. Navigation only
+// moves the cursor. The keyframes of the flight under way are collected in
+// a trail and resampled into an entry on landing.
+class FlightHistory
+{
+public:
+  FlightHistory() :
+      Start(0), Count(0), Cursor(-1)
+  {
+    this->Trail.reserve(1024);
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Allocate room for max stops, forgetting the history so far.
+  void SetMaxHistory(const int& max)
+  {
+    this->Entries.assign(max, FlightHistoryEntry());
+    this->Start = 0;
+    this->Count = 0;
+    this->Cursor = -1;
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Start the trail of a flight departing from a keyframe. If the camera
+  // was moved since the current stop, the departure is recorded as a stop
+  // first, reached on a straight path, and returned.
+  FlightHistoryEntry* BeginTrail(const FlightKeyframe& departure)
+  {
+    FlightHistoryEntry* recorded = 0;
+    if (this->Cursor < 0 || !this->GetCurrent().GetStop().SameView(departure))
+    {
+      FlightHistoryEntry& entry = this->AddEntry();
+      recorded = &entry;
+      const FlightKeyframe from =
+          this->Cursor > 0 ? this->At(this->Cursor - 1).GetStop() : departure;
+      for (int i = 0; i < FlightHistoryEntry::NumberOfKeyframes; ++i)
+      {
+        double t = i / (FlightHistoryEntry::NumberOfKeyframes - 1.0);
+        FlightKeyframe& keyframe = entry.Path[i];
+        keyframe = departure;
+        for (int j = 0; j < 2; ++j)
+        {
+          keyframe.FocalPoint[j] = static_cast<float>(from.FocalPoint[j]
+              + t * (departure.FocalPoint[j] - from.FocalPoint[j]));
+        }
+        keyframe.ParallelScale = static_cast<float>(from.ParallelScale
+            + t * (departure.ParallelScale - from.ParallelScale));
+      }
+    }
+    this->Trail.clear();
+    this->Trail.push_back(departure);
+    return recorded;
+  }
+
+  //-------------------------------------------------------------------------
+  void AddToTrail(const FlightKeyframe& keyframe)
+  {
+    this->Trail.push_back(keyframe);
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Record the trail as a new stop, sampling it evenly, and return it.
+  FlightHistoryEntry* EndTrail()
+  {
+    size_t numTrail = this->Trail.size();
+    if (numTrail == 0)
+    {
+      return 0;
+    }
+    FlightHistoryEntry& entry = this->AddEntry();
+    for (int i = 0; i < FlightHistoryEntry::NumberOfKeyframes; ++i)
+    {
+      size_t j = (numTrail - 1) * i / (FlightHistoryEntry::NumberOfKeyframes - 1);
+      entry.Path[i] = this->Trail[j];
+    }
+    this->Trail.clear();
+    return &entry;
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Step the cursor back, returning the entry whose path is to be replayed
+  // in reverse, or 0 at the oldest stop.
+  const FlightHistoryEntry* GetHistoryBackwards()
+  {
+    if (this->Cursor <= 0)
+    {
+      return 0;
+    }
+    return &this->At(this->Cursor--);
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Step the cursor forward, returning the entry whose path is to be
+  // replayed, or 0 at the latest stop.
+  const FlightHistoryEntry* GetHistoryForwards()
+  {
+    if (this->Cursor + 1 >= this->Count)
+    {
+      return 0;
+    }
+    return &this->At(++this->Cursor);
+  }
+
+private:
+  //-------------------------------------------------------------------------
+  FlightHistoryEntry& At(int i)
+  {
+    return this->Entries[(this->Start + i) % this->Entries.size()];
+  }
+
+  //-------------------------------------------------------------------------
+  FlightHistoryEntry& GetCurrent()
+  {
+    return this->At(this->Cursor);
+  }
+
+  //-------------------------------------------------------------------------
+  FlightHistoryEntry& AddEntry()
+  {
+    this->Count = this->Cursor + 1;
+    if (this->Count == static_cast<int>(this->Entries.size()))
+    {
+      this->Start = (this->Start + 1) % this->Entries.size();
+      --this->Count;
+    }
+    this->Cursor = this->Count++;
+    return this->At(this->Cursor);
+  }
+
+  std::vector<FlightHistoryEntry> Entries;
+  int Start;
+  int Count;
+  int Cursor;
+  std::vector<FlightKeyframe> Trail;
+};
+
+//-------------------------------------------------------------------------
+// Description:
+// Douglas-Peucker simplification of a path: keep the points that stray
+// further than tolerance from the chord between the points kept either side
+// of them. The end points are always kept.
+static void vtkOffScreenWidgetSimplifyPath(vtkPoints* path, double tolerance,
+    vtkPoints* simplified)
+{
+  vtkIdType numPoints = path->GetNumberOfPoints();
+  std::vector<char> keep(numPoints, 0);
+  if (numPoints > 0)
+  {
+    keep[0] = 1;
+    keep[numPoints - 1] = 1;
+  }
+  std::vector<std::pair<vtkIdType, vtkIdType> > spans;
+  if (numPoints > 2)
+  {
+    spans.push_back(std::make_pair(static_cast<vtkIdType>(0), numPoints - 1));
+  }
+  double tolerance2 = tolerance * tolerance;
+  while (!spans.empty())
+  {
+    vtkIdType first = spans.back().first;
+    vtkIdType last = spans.back().second;
+    spans.pop_back();
+    double a[3], b[3], p[3];
+    path->GetPoint(first, a);
+    path->GetPoint(last, b);
+    double ab[2] = { b[0] - a[0], b[1] - a[1] };
+    double ab2 = ab[0] * ab[0] + ab[1] * ab[1];
+
+    // Farthest point from the chord (or from a, if the span is a loop)
+    vtkIdType farthest = -1;
+    double farthest2 = tolerance2;
+    for (vtkIdType i = first + 1; i < last; ++i)
+    {
+      path->GetPoint(i, p);
+      double ap[2] = { p[0] - a[0], p[1] - a[1] };
+      double distance2;
+      if (ab2 > 0.0)
+      {
+        double cross = ab[0] * ap[1] - ab[1] * ap[0];
+        double t = (ab[0] * ap[0] + ab[1] * ap[1]) / ab2;
+        if (t < 0.0)
+        {
+          distance2 = ap[0] * ap[0] + ap[1] * ap[1];
+        }
+        else if (t > 1.0)
+        {
+          distance2 = (p[0] - b[0]) * (p[0] - b[0])
+              + (p[1] - b[1]) * (p[1] - b[1]);
+        }
+        else
+        {
+          distance2 = cross * cross / ab2;
+        }
+      }
+      else
+      {
+        distance2 = ap[0] * ap[0] + ap[1] * ap[1];
+      }
+      if (distance2 > farthest2)
+      {
+        farthest = i;
+        farthest2 = distance2;
+      }
+    }
+    if (farthest >= 0)
+    {
+      keep[farthest] = 1;
+      if (farthest - first > 1)
+      {
+        spans.push_back(std::make_pair(first, farthest));
+      }
+      if (last - farthest > 1)
+      {
+        spans.push_back(std::make_pair(farthest, last));
+      }
+    }
+  }
 
+  simplified->Reset();
+  for (vtkIdType i = 0; i < numPoints; ++i)
+  {
+    if (keep[i])
+    {
+      simplified->InsertNextPoint(path->GetPoint(i));
+    }
+  }
+}
 
 //-------------------------------------------------------------------------
-struct HistoryElement
+// Description:
+// The camera path of a flight: smoothing splines through the itinerary and
+// the zoom knots, compiled once into a table of camera placements spaced
+// evenly along the path. Compiling subdivides each span of the splines
+// until linear interpolation between samples strays no further than a
+// tolerance in pixels, so the path is as fine as its shape needs whatever
+// the number of itinerary points. Length is measured on screen: panning by
+// the view height or zooming by a factor of e cover the same distance.
+// Placing the camera at a fraction of the flight is then a table lookup.
+// A table compiled earlier, such as that of a history entry, can be followed
+// in either direction instead. The sample buffers are kept between paths.
+class vtkOffScreenWidgetCameraPath
 {
-  HistoryElement(double x = 0.0, double y = 0.0, double z = 0.0) :
-      x(x), y(y), z(z) { }
+public:
+  vtkOffScreenWidgetCameraPath() :
+      MaximumT(0.0), ViewportHeight(1.0), Tolerance(0.5), Reversed(false)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      this->Splines[i] = vtkSmartPointer<vtkKochanekSpline>::New();
+    }
+    this->Samples.reserve(3 * 1024);
+    this->Length.reserve(1024);
+    this->CompiledTable.reserve(3 * 2048);
+    this->Table = &this->CompiledTable;
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Start a new path, with the bias, tension and continuity of the x,y
+  // splines. The zoom spline is a Catmull-Rom spline.
+  void Initialize(double bias, double tension, double continuity)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      this->Splines[i]->RemoveAllPoints();
+      this->Splines[i]->SetClosed(false);
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+      this->Splines[i]->SetDefaultBias(bias);
+      this->Splines[i]->SetDefaultTension(tension);
+      this->Splines[i]->SetDefaultContinuity(continuity);
+    }
+    this->Splines[2]->SetDefaultBias(0.0);
+    this->Splines[2]->SetDefaultTension(0.0);
+    this->Splines[2]->SetDefaultContinuity(0.0);
+    this->MaximumT = 0.0;
+    this->CompiledTable.clear();
+    this->Table = &this->CompiledTable;
+    this->Reversed = false;
+  }
+
+  //-------------------------------------------------------------------------
+  void AddPosition(double t, const double p[3])
+  {
+    this->Splines[0]->AddPoint(t, p[0]);
+    this->Splines[1]->AddPoint(t, p[1]);
+    this->MaximumT = std::max(this->MaximumT, t);
+  }
+
+  //-------------------------------------------------------------------------
+  void AddZoom(double t, double zoom)
+  {
+    this->Splines[2]->AddPoint(t, zoom);
+    this->MaximumT = std::max(this->MaximumT, t);
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Sample the splines to within tolerance pixels of a viewport of the
+  // given height and build the lookup table.
+  void Compile(double viewportHeight, double tolerance)
+  {
+    this->ViewportHeight = std::max(viewportHeight, 1.0);
+    this->Tolerance = std::max(tolerance, 0.01);
+    for (int i = 0; i < 3; ++i)
+    {
+      this->Splines[i]->Compute();
+    }
+
+    // Adaptive samples, x, y, zoom in turn, one or more per unit of t
+    std::vector<double>& samples = this->Samples;
+    samples.clear();
+    double a[3];
+    this->Sample(0.0, a);
+    samples.insert(samples.end(), a, a + 3);
+    int numSpans = std::max(1, static_cast<int>(ceil(this->MaximumT)));
+    for (int i = 0; i < numSpans; ++i)
+    {
+      double t1 = std::min(i + 1.0, this->MaximumT);
+      double b[3];
+      this->Sample(t1, b);
+      this->Subdivide(i, a, t1, b, 0, samples);
+      std::copy(b, b + 3, a);
+    }
+
+    // Length along the samples
+    vtkIdType numSamples = static_cast<vtkIdType>(samples.size() / 3);
+    std::vector<double>& length = this->Length;
+    length.assign(numSamples, 0.0);
+    for (vtkIdType i = 1; i < numSamples; ++i)
+    {
+      length[i] = length[i - 1]
+          + this->ScreenDistance(&samples[3 * (i - 1)], &samples[3 * i]);
+    }
+    double totalLength = length[numSamples - 1];
+    if (totalLength <= 0.0)
+    {
+      // The camera stays put; spread the samples over the flight instead
+      for (vtkIdType i = 0; i < numSamples; ++i)
+      {
+        length[i] = i;
+      }
+      totalLength = std::max(numSamples - 1.0, 1.0);
+    }
+
+    // Resample at even spacing, twice as finely as the adaptive samples
+    // to keep the detail where they are dense
+    vtkIdType numEntries = std::max(static_cast<vtkIdType>(2), 2 * numSamples);
+    this->Table = &this->CompiledTable;
+    this->Reversed = false;
+    this->CompiledTable.resize(3 * numEntries);
+    vtkIdType j = 0;
+    for (vtkIdType k = 0; k < numEntries; ++k)
+    {
+      double s = totalLength * k / (numEntries - 1);
+      while (j < numSamples - 2 && length[j + 1] < s)
+      {
+        ++j;
+      }
+      vtkIdType j1 = std::min(j + 1, numSamples - 1);
+      double span = length[j1] - length[j];
+      double f = span > 0.0 ? (s - length[j]) / span : 0.0;
+      f = std::min(std::max(f, 0.0), 1.0);
+      for (int c = 0; c < 3; ++c)
+      {
+        this->CompiledTable[3 * k + c] = samples[3 * j + c]
+            + f * (samples[3 * j1 + c] - samples[3 * j + c]);
+      }
+    }
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Give the compiled table to table, taking table's storage in exchange to
+  // compile the next path into.
+  void SwapTable(std::vector<double>& table)
+  {
+    this->CompiledTable.swap(table);
+    this->CompiledTable.clear();
+    this->Table = &this->CompiledTable;
+    this->Reversed = false;
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Follow a table compiled earlier, from its end if reversed. The table is
+  // not copied, so it must be left alone until the path is reinitialized
+  // or detached.
+  void UseTable(const std::vector<double>& table, bool reversed)
+  {
+    this->Table = &table;
+    this->Reversed = reversed;
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Copy the table followed, if it is not this path's own, so the original
+  // can be changed or freed.
+  void DetachTable()
+  {
+    if (this->Table != &this->CompiledTable)
+    {
+      this->CompiledTable = *this->Table;
+      this->Table = &this->CompiledTable;
+    }
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // The camera placement at fraction u (0 to 1) of the length of the path.
+  void Evaluate(double u, double xy[2], double& zoom) const
+  {
+    vtkIdType numEntries = this->GetNumberOfSamples();
+    if (numEntries == 0)
+    {
+      xy[0] = xy[1] = zoom = 0.0;
+      return;
+    }
+    u = std::min(std::max(u, 0.0), 1.0);
+    double x = (this->Reversed ? 1.0 - u : u) * (numEntries - 1);
+    vtkIdType i = std::min(static_cast<vtkIdType>(x), numEntries - 1);
+    vtkIdType i1 = std::min(i + 1, numEntries - 1);
+    double f = x - i;
+    const double* p = &(*this->Table)[3 * i];
+    const double* q = &(*this->Table)[3 * i1];
+    xy[0] = p[0] + f * (q[0] - p[0]);
+    xy[1] = p[1] + f * (q[1] - p[1]);
+    zoom = p[2] + f * (q[2] - p[2]);
+  }
+
+  //-------------------------------------------------------------------------
+  vtkIdType GetNumberOfSamples() const
+  {
+    return static_cast<vtkIdType>(this->Table->size() / 3);
+  }
+
+private:
+  //-------------------------------------------------------------------------
+  void Sample(double t, double s[3])
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      s[i] = this->Splines[i]->Evaluate(t);
+    }
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // The distance between two camera placements in view heights, taking a
+  // zoom by a factor of e as one view height.
+  double ScreenDistance(const double a[3], const double b[3]) const
+  {
+    double zoom = 0.5 * (a[2] + b[2]);
+    double pan = sqrt((b[0] - a[0]) * (b[0] - a[0])
+        + (b[1] - a[1]) * (b[1] - a[1]));
+    double distance = zoom > 0.0 ? pan / (2.0 * zoom) : 0.0;
+    if (a[2] > 0.0 && b[2] > 0.0)
+    {
+      distance += fabs(log(b[2] / a[2]));
+    }
+    return distance;
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Append samples between a (already appended) and b (appended last) until
+  // the midpoint of each part is within tolerance of the chord: in display
+  // pixels for the pan, and at the edge of the view for the zoom.
+  void Subdivide(double t0, const double a[3], double t1, const double b[3],
+      int depth, std::vector<double>& samples)
+  {
+    double tm = 0.5 * (t0 + t1);
+    double m[3];
+    this->Sample(tm, m);
+    double error = 0.0;
+    if (m[2] > 0.0)
+    {
+      double pixelsPerUnit = this->ViewportHeight / (2.0 * m[2]);
+      double dx = m[0] - 0.5 * (a[0] + b[0]);
+      double dy = m[1] - 0.5 * (a[1] + b[1]);
+      double dz = m[2] - 0.5 * (a[2] + b[2]);
+      error = std::max(sqrt(dx * dx + dy * dy) * pixelsPerUnit,
+          fabs(dz) * pixelsPerUnit);
+    }
+
+    // Check a couple of levels regardless, as a span can bend both ways
+    // with a straight midpoint
+    if (depth < 2 || (depth < 12 && error > this->Tolerance))
+    {
+      this->Subdivide(t0, a, tm, m, depth + 1, samples);
+      this->Subdivide(tm, m, t1, b, depth + 1, samples);
+    }
+    else
+    {
+      samples.insert(samples.end(), b, b + 3);
+    }
+  }
+
+  vtkSmartPointer<vtkKochanekSpline> Splines[3];
+  double MaximumT;
+  double ViewportHeight;
+  double Tolerance;
+  std::vector<double> Samples;
+  std::vector<double> Length;
+  std::vector<double> CompiledTable;
+  const std::vector<double>* Table;
+  bool Reversed;
+};
+
+//-------------------------------------------------------------------------
+// Description:
+// An angular index over the cells of the off-screen proxy polydata. Proxies
+// lie on a ring about the display centre, so each cell is reduced to the
+// range of angles and radii it covers. The ranges are sorted by their first
+// angle, and a hit test is a binary search on the angle of the cursor
+// followed by a radius test. The cells of every "Hull id" are listed too, so
+// that a highlight only visits the cells of its hull. The index is rebuilt
+// only when the proxy geometry or the display centre changes.
+class vtkOffScreenWidgetPickIndex
+{
+public:
+  vtkOffScreenWidgetPickIndex() :
+      PointsTime(0), NumberOfCells(0)
+  {
+    this->Centre[0] = this->Centre[1] = 0.0;
+  }
+
+  //-------------------------------------------------------------------------
+  void Update(vtkPolyData* polyData, const double centre[2], double tolerance)
+  {
+    vtkPoints* points = polyData->GetPoints();
+    vtkIdType numCells = polyData->GetNumberOfCells();
+    unsigned long pointsTime = points ? points->GetMTime() : 0;
+    if (pointsTime == this->PointsTime && numCells == this->NumberOfCells
+        && centre[0] == this->Centre[0] && centre[1] == this->Centre[1])
+    {
+      return;
+    }
+    this->PointsTime = pointsTime;
+    this->NumberOfCells = numCells;
+    this->Centre[0] = centre[0];
+    this->Centre[1] = centre[1];
+    this->Ranges.clear();
+    this->ReachEnd.clear();
+    this->HullCells.clear();
+    if (!points || numCells == 0)
+    {
+      return;
+    }
+
+    this->Ranges.reserve(numCells);
+    vtkIdType npts;
+    vtkIdType* pts;
+    double x[3];
+    for (vtkIdType cellId = 0; cellId < numCells; ++cellId)
+    {
+      polyData->GetCellPoints(cellId, npts, pts);
+      if (npts == 0)
+      {
+        continue;
+      }
+
+      // Angles are measured from the first point so that a cell crossing
+      // the negative x axis gives one contiguous range
+      points->GetPoint(pts[0], x);
+      double first = atan2(x[1] - centre[1], x[0] - centre[0]);
+      double minAngle = 0.0;
+      double maxAngle = 0.0;
+      double minRadius = VTK_DOUBLE_MAX;
+      double maxRadius = 0.0;
+      for (vtkIdType j = 0; j < npts; ++j)
+      {
+        points->GetPoint(pts[j], x);
+        double dx = x[0] - centre[0];
+        double dy = x[1] - centre[1];
+        double angle = atan2(dy, dx) - first;
+        if (angle > vtkMath::Pi())
+        {
+          angle -= 2.0 * vtkMath::Pi();
+        }
+        else if (angle <= -vtkMath::Pi())
+        {
+          angle += 2.0 * vtkMath::Pi();
+        }
+        double radius = sqrt(dx * dx + dy * dy);
+        minAngle = std::min(minAngle, angle);
+        maxAngle = std::max(maxAngle, angle);
+        minRadius = std::min(minRadius, radius);
+        maxRadius = std::max(maxRadius, radius);
+      }
+
+      // Widen by the tolerance (in pixels) at the inner edge of the cell
+      double spread = tolerance / std::max(minRadius, 1.0);
+      Range range;
+      range.Begin = first + minAngle - spread;
+      range.End = first + maxAngle + spread;
+      range.Inner = minRadius - tolerance;
+      range.Outer = maxRadius + tolerance;
+      range.CellId = cellId;
+      if (range.Begin < -vtkMath::Pi())
+      {
+        range.Begin += 2.0 * vtkMath::Pi();
+        range.End += 2.0 * vtkMath::Pi();
+      }
+      this->Ranges.push_back(range);
+
+      // A range running past pi also covers the start of the circle
+      if (range.End > vtkMath::Pi())
+      {
+        range.Begin -= 2.0 * vtkMath::Pi();
+        range.End -= 2.0 * vtkMath::Pi();
+        this->Ranges.push_back(range);
+      }
+    }
+    std::sort(this->Ranges.begin(), this->Ranges.end());
+
+    // The furthest any range up to each one reaches, which bounds the
+    // backward scan in FindCell()
+    size_t numRanges = this->Ranges.size();
+    this->ReachEnd.resize(numRanges);
+    double reach = -VTK_DOUBLE_MAX;
+    for (size_t i = 0; i < numRanges; ++i)
+    {
+      reach = std::max(reach, this->Ranges[i].End);
+      this->ReachEnd[i] = reach;
+    }
+
+    vtkIdTypeArray* hullIds = vtkIdTypeArray::SafeDownCast(
+        polyData->GetCellData()->GetAbstractArray("Hull id"));
+    if (hullIds)
+    {
+      for (vtkIdType cellId = 0; cellId < numCells; ++cellId)
+      {
+        this->HullCells[hullIds->GetValue(cellId)].push_back(cellId);
+      }
+    }
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Return the last drawn cell under a display position, or -1.
+  vtkIdType FindCell(const double position[2]) const
+  {
+    double dx = position[0] - this->Centre[0];
+    double dy = position[1] - this->Centre[1];
+    Range key;
+    key.Begin = atan2(dy, dx);
+    double radius = sqrt(dx * dx + dy * dy);
+
+    vtkIdType cellId = -1;
+    std::vector<Range>::const_iterator it = std::upper_bound(
+        this->Ranges.begin(), this->Ranges.end(), key);
+    for (size_t i = it - this->Ranges.begin();
+        i > 0 && this->ReachEnd[i - 1] >= key.Begin; --i)
+    {
+      const Range& range = this->Ranges[i - 1];
+      if (range.End >= key.Begin && radius >= range.Inner
+          && radius <= range.Outer && range.CellId > cellId)
+      {
+        cellId = range.CellId;
+      }
+    }
+    return cellId;
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // The cells of a hull, or 0 if there are none.
+  const std::vector<vtkIdType>* GetHullCells(vtkIdType hullId) const
+  {
+    std::map<vtkIdType, std::vector<vtkIdType> >::const_iterator it =
+        this->HullCells.find(hullId);
+    return it == this->HullCells.end() ? 0 : &it->second;
+  }
+
+private:
+  struct Range
+  {
+    double Begin;
+    double End;
+    double Inner;
+    double Outer;
+    vtkIdType CellId;
+
+    bool operator<(const Range& other) const
+    {
+      return this->Begin < other.Begin;
+    }
+  };
+
+  std::vector<Range> Ranges;
+  std::vector<double> ReachEnd;
+  std::map<vtkIdType, std::vector<vtkIdType> > HullCells;
+
+  // What the index was built from.
+  unsigned long PointsTime;
+  vtkIdType NumberOfCells;
+  double Centre[2];
+};
+
+//-------------------------------------------------------------------------
+// Description:
+// Copy the settings of a router, but not its flight map, to another.
+static void vtkOffScreenWidgetCopyRouterSettings(vtkFlightMapRouter* source,
+    vtkFlightMapRouter* target)
+{
+  target->SetEdgeWeightArrayName(source->GetEdgeWeightArrayName());
+  target->SetSearchStrategy(source->GetSearchStrategy());
+  target->SetTreeRouting(source->GetTreeRouting());
+  target->SetCacheRoutes(source->GetCacheRoutes());
+  target->SetMaximumNumberOfCachedRoutes(
+      source->GetMaximumNumberOfCachedRoutes());
+  target->SetMaximumRouteCacheSize(source->GetMaximumRouteCacheSize());
+}
+
+//-------------------------------------------------------------------------
+// Description:
+// Plans flights on background threads so that a click returns at once.
+// Every click submits a job with the router the widget holds at the time,
+// which routes over its own snapshot of the flight map, so a job is never
+// affected by later changes to the map. Each router has a lane with its own
+// lock, so jobs only wait for jobs using the same router. A job superseded
+// by a later click or a cancel skips its routing, or has its search aborted
+// by the router's progress observer, and its result is discarded. Jobs never
+// plan on the GUI thread: a job that cannot get a thread waits for one and
+// is started again by Poll(), which also joins the finished jobs.
+class vtkOffScreenWidgetFlightPlanner
+{
+public:
+  // Jobs sharing a router take turns with it.
+  struct Lane
+  {
+    vtkOffScreenWidgetFlightPlanner* Planner;
+    vtkSmartPointer<vtkFlightMapRouter> Router;
+    vtkSmartPointer<vtkMutexLock> Lock;
+    vtkSmartPointer<vtkCallbackCommand> AbortCommand;
+    // The generation of the job routing, guarded by the planner's lock.
+    int Generation;
+    int NumberOfJobs;
+  };
+
+  struct Job
+  {
+    vtkOffScreenWidget* Widget;
+    Lane* RouterLane;
+    int Generation;
+    int ThreadId;
+    double Departure[3];
+    double Arrival[3];
+    vtkPoints* Itinerary;
+    bool Connected;
+    bool Planned;
+    bool Finished;
+  };
+
+  vtkOffScreenWidgetFlightPlanner() :
+      Generation(0)
+  {
+    this->Threader = vtkSmartPointer<vtkMultiThreader>::New();
+    this->Lock = vtkSmartPointer<vtkMutexLock>::New();
+  }
+
+  ~vtkOffScreenWidgetFlightPlanner()
+  {
+    // Cancelling aborts the searches under way, so the joins are short
+    this->Cancel();
+    for (size_t i = 0; i < this->Jobs.size(); ++i)
+    {
+      // Jobs still waiting for a thread have none to join
+      if (this->Jobs[i]->ThreadId >= 0)
+      {
+        this->Threader->TerminateThread(this->Jobs[i]->ThreadId);
+      }
+      this->Release(this->Jobs[i]);
+    }
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Start planning a flight with router, superseding any earlier job.
+  void Submit(vtkOffScreenWidget* widget, vtkFlightMapRouter* router,
+      const double departure[3], const double arrival[3])
+  {
+    Job* job = new Job;
+    job->Widget = widget;
+    job->RouterLane = this->GetLane(router);
+    ++job->RouterLane->NumberOfJobs;
+    this->Lock->Lock();
+    job->Generation = ++this->Generation;
+    this->Lock->Unlock();
+    for (int i = 0; i < 3; ++i)
+    {
+      job->Departure[i] = departure[i];
+      job->Arrival[i] = arrival[i];
+    }
+    job->Itinerary = vtkPoints::New();
+    job->Connected = false;
+    job->Planned = false;
+    job->Finished = false;
+    job->ThreadId = -1;
+    this->Jobs.push_back(job);
+    this->Start(job);
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Discard the result of every job submitted so far. Return true if the
+  // latest job had yet to deliver its flight.
+  bool Cancel()
+  {
+    this->Lock->Lock();
+    bool pending = false;
+    for (size_t i = 0; i < this->Jobs.size(); ++i)
+    {
+      pending = pending || this->Jobs[i]->Generation == this->Generation;
+    }
+    ++this->Generation;
+    this->Lock->Unlock();
+    return pending;
+  }
+
+  //-------------------------------------------------------------------------
+  // Description:
+  // Join the finished jobs and retry starting the latest job if it is still
+  // waiting for a thread. Return true, with its itinerary, if the latest job
+  // has planned a flight since the last poll.
+  bool Poll(vtkSmartPointer<vtkPoints>& itinerary, bool& connected)
+  {
+    bool planned = false;
+    size_t i = 0;
+    while (i < this->Jobs.size())
+    {
+      Job* job = this->Jobs[i];
+      this->Lock->Lock();
+      bool finished = job->Finished;
+      bool current = job->Generation == this->Generation;
+      this->Lock->Unlock();
+      if (!finished && job->ThreadId < 0)
+      {
+        if (current)
+        {
+          // Still waiting for a thread
+          this->Start(job);
+          ++i;
+          continue;
+        }
+        finished = true; // Superseded before it started
+      }
+      if (!finished)
+      {
+        ++i;
+        continue;
+      }
+
+      if (job->ThreadId >= 0)
+      {
+        this->Threader->TerminateThread(job->ThreadId);
+      }
+      if (current && job->Planned)
+      {
+        itinerary = job->Itinerary;
+        connected = job->Connected;
+        planned = true;
+      }
+      this->Release(job);
+      this->Jobs.erase(this->Jobs.begin() + i);
+    }
+    return planned;
+  }
 
+private:
   //-------------------------------------------------------------------------
-  HistoryElement(double* p)
+  // Description:
+  // The lane of router, created (and its abort observer added) on first use.
+  // Only called on the GUI thread, and no job is using a new lane's router.
+  Lane* GetLane(vtkFlightMapRouter* router)
   {
-    if (p)
+    for (size_t i = 0; i < this->Lanes.size(); ++i)
     {
-      this->x = p[0];
-      this->y = p[1];
-      this->z = p[2];
+      if (this->Lanes[i]->Router == router)
+      {
+        return this->Lanes[i];
+      }
     }
+    Lane* lane = new Lane;
+    lane->Planner = this;
+    lane->Router = router;
+    lane->Lock = vtkSmartPointer<vtkMutexLock>::New();
+    lane->AbortCommand = vtkSmartPointer<vtkCallbackCommand>::New();
+    lane->AbortCommand->SetClientData(lane);
+    lane->AbortCommand->SetCallback(vtkOffScreenWidgetFlightPlanner::Abort);
+    lane->Generation = 0;
+    lane->NumberOfJobs = 0;
+    router->AddObserver(vtkCommand::ProgressEvent, lane->AbortCommand);
+    this->Lanes.push_back(lane);
+    return lane;
   }
-  double x;
-  double y;
-  double z;
-};
 
-//-------------------------------------------------------------------------
-class FlightHistory: public std::deque<HistoryElement>
-{
-public:
-  FlightHistory()
+  //-------------------------------------------------------------------------
+  // Description:
+  // Delete a joined (or never started) job, and its lane once no other job
+  // uses it.
+  void Release(Job* job)
   {
-    this->Max = 0;
-    this->Current = -1;
-    this->Front = -1;
+    Lane* lane = job->RouterLane;
+    if (--lane->NumberOfJobs == 0)
+    {
+      lane->Router->RemoveObserver(lane->AbortCommand);
+      this->Lanes.erase(
+          std::find(this->Lanes.begin(), this->Lanes.end(), lane));
+      delete lane;
+    }
+    job->Itinerary->Delete();
+    delete job;
   }
 
   //-------------------------------------------------------------------------
-  void SetMaxHistory(const int& max)
+  // Description:
+  // Run a job on a thread of its own. Returns false if every thread slot is
+  // taken, leaving the job waiting.
+  bool Start(Job* job)
   {
-    this->Max = max;
+    job->ThreadId = this->Threader->SpawnThread(
+        vtkOffScreenWidgetFlightPlanner::Run, job);
+    return job->ThreadId >= 0;
   }
 
   //-------------------------------------------------------------------------
-  void AddElement(const HistoryElement& element)
+  static VTK_THREAD_RETURN_TYPE Run(void* arg)
   {
-    if (this->Front == this->Max - 1)
-    {
-      this->pop_front();
-    }
-    this->push_back(element);
-    ++this->Current;
-    this->Front = this->Current;
+    vtkMultiThreader::ThreadInfo* info =
+        static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+    vtkOffScreenWidgetFlightPlanner::Execute(static_cast<Job*>(info->UserData));
+    return VTK_THREAD_RETURN_VALUE;
   }
 
   //-------------------------------------------------------------------------
-  HistoryElement GetHistoryForwards()
+  static void Execute(Job* job)
   {
-    if (this->Current < this->Front)
+    Lane* lane = job->RouterLane;
+    vtkOffScreenWidgetFlightPlanner* self = lane->Planner;
+    lane->Lock->Lock();
+    self->Lock->Lock();
+    bool current = job->Generation == self->Generation;
+    lane->Generation = job->Generation;
+    self->Lock->Unlock();
+    if (current)
     {
-      ++this->Current;
+      job->Connected = job->Widget->PlanFlight(lane->Router, job->Departure,
+          job->Arrival, job->Itinerary);
+      job->Planned = !lane->Router->GetAbortSearch();
     }
-    return this->at(this->Current);
+    lane->Lock->Unlock();
+
+    self->Lock->Lock();
+    job->Finished = true;
+    self->Lock->Unlock();
   }
 
   //-------------------------------------------------------------------------
-  HistoryElement GetHistoryBackwards()
+  // Description:
+  // Observes the progress of a lane's router, on the thread of the job
+  // routing, and aborts the search once the job has been superseded.
+  static void Abort(vtkObject* vtkNotUsed(caller),
+      unsigned long vtkNotUsed(event), void* clientdata,
+      void* vtkNotUsed(calldata))
   {
-    if (this->Current > 0)
+    Lane* lane = static_cast<Lane*>(clientdata);
+    vtkOffScreenWidgetFlightPlanner* self = lane->Planner;
+    self->Lock->Lock();
+    bool superseded = lane->Generation != self->Generation;
+    self->Lock->Unlock();
+    if (superseded)
     {
-      --this->Current;
+      lane->Router->AbortSearchOn();
     }
-    return this->at(this->Current);
   }
 
-private:
-  int Max;
-  int Current;
-  int Front;
+  vtkSmartPointer<vtkMultiThreader> Threader;
+  // Guards Generation, the lane generations and the Finished flags.
+  vtkSmartPointer<vtkMutexLock> Lock;
+  int Generation;
+  std::vector<Job*> Jobs;
+  std::vector<Lane*> Lanes;
 };
 
 //-------------------------------------------------------------------------
 vtkStandardNewMacro(vtkOffScreenWidget)
-vtkCxxSetObjectMacro(vtkOffScreenWidget, FlightMap, vtkFlightMapFilter)
 
 //-------------------------------------------------------------------------
 vtkOffScreenWidget::vtkOffScreenWidget()
@@ -143,7 +1120,7 @@ vtkOffScreenWidget::vtkOffScreenWidget()
   this->StopTimerId = -1;
   this->DimmerTimerDuration = 40;
   this->DimmerTimerId = -1;
-  this->FlightTimerDuration = 100;
+  this->FlightDuration = 4.0;
   this->FlightTimerId = -1;
 
   this->StartDimness = 0.25;
@@ -153,22 +1130,45 @@ vtkOffScreenWidget::vtkOffScreenWidget()
   this->DimStepCount = 0;
 
   this->Picker = vtkPropPicker::New();
-  this->CellLocator = vtkSmartPointer<vtkCellLocator>::New();
-  this->CellLocator->SetTolerance(2.0);
-  this->CellLocator->SetNumberOfCellsPerBucket(1);
-  this->PointLocator = vtkSmartPointer<vtkKdTree>::New();
-  this->PointLocator->OmitZPartitioning();
-  this->PointLocator->SetTolerance(0.0001);
-
-  this->Itinerary = vtkSmartPointer<vtkPoints>::New();
+  this->PickIndex = new vtkOffScreenWidgetPickIndex;
+  this->PickTolerance = 2.0;
+
   this->FlightMap = 0;
-  this->LastItineraryIndex = -1;
-  this->CurrentItineraryIndex = -1;
+  // The flight map is a spanning forest, so routes are found through the
+  // router's tree index; its search strategy and route cache are left at
+  // their defaults as they are not used.
+  this->Router = vtkSmartPointer<vtkFlightMapRouter>::New();
+  this->Planner = new vtkOffScreenWidgetFlightPlanner;
+  this->RenderCallbackCommand = vtkCallbackCommand::New();
+  this->RenderCallbackCommand->SetClientData(this);
+  this->RenderCallbackCommand->SetCallback(
+      vtkOffScreenWidget::ProcessRenderEvents);
+  this->FlightPath = new vtkOffScreenWidgetCameraPath;
+  this->HistoryPath = new vtkOffScreenWidgetCameraPath;
+  this->FlightPathTolerance = 0.5;
+  this->NumberOfFlightPathSamples = 0;
+  this->ItineraryTolerance = 1.0;
+  this->ItineraryReductionRatio = 1.0;
+  this->FlightMaxZoom = 0.0;
+  this->FlightLandingZoom = 0.0;
+  this->CurrentFlightDuration = 0.0;
+  this->FlightStartTime = 0.0;
+  this->FlightTakeOffTime = 0.0;
+  this->FlightFrameRate = 30.0;
+  this->FlightFrame = -1;
+  this->NumberOfFlightFrames = 0;
+  this->NumberOfDroppedFlightFrames = 0;
+  this->FlightFramesPerSecond = 0.0;
+  this->NumberOfUnplannedFlights = 0;
   this->FlightType = 0;
   this->FlightSpeedBias = 0;
   this->HistoryBufferLength = 250;
   this->History = new FlightHistory;
   this->History->SetMaxHistory(this->HistoryBufferLength);
+  this->ReplayingHistory = false;
+  this->ReplayViewUp[0] = 0.0;
+  this->ReplayViewUp[1] = 1.0;
+  this->ReplayViewUp[2] = 0.0;
 
   // Okay, define the events for this widget. Note that we look for extra events
   // (like button press) because without it the hover widget thinks nothing has changed
@@ -208,9 +1208,14 @@ vtkOffScreenWidget::vtkOffScreenWidget()
 //-------------------------------------------------------------------------
 vtkOffScreenWidget::~vtkOffScreenWidget()
 {
+  delete this->Planner;
   this->SetFlightMap(0);
   this->SetInteractor(0);
+  this->RenderCallbackCommand->Delete();
   delete this->History;
+  delete this->FlightPath;
+  delete this->HistoryPath;
+  delete this->PickIndex;
   this->Picker->Delete();
   this->SetWidgetRepresentation(0);
 }
@@ -262,6 +1267,8 @@ void vtkOffScreenWidget::SetEnabled(int enabling)
       this->WidgetRep->SetRenderer(this->CurrentRenderer);
       this->WidgetRep->BuildRepresentation();
       this->CurrentRenderer->AddViewProp(this->WidgetRep);
+      this->CurrentRenderer->AddObserver(vtkCommand::EndEvent,
+          this->RenderCallbackCommand, this->Priority);
     }
   }
 
@@ -279,12 +1286,80 @@ void vtkOffScreenWidget::SetEnabled(int enabling)
     this->InvokeEvent(vtkCommand::DisableEvent, NULL);
     if (this->CurrentRenderer)
     {
+      this->CurrentRenderer->RemoveObserver(this->RenderCallbackCommand);
       this->CurrentRenderer->RemoveViewProp(this->WidgetRep);
       this->SetCurrentRenderer(NULL);
     }
   }
 }
 
+//----------------------------------------------------------------------
+void vtkOffScreenWidget::SetFlightMap(vtkFlightMapFilter* flightMap)
+{
+  if (flightMap == this->FlightMap)
+  {
+    return;
+  }
+  if (this->FlightMap)
+  {
+    this->FlightMap->UnRegister(this);
+  }
+  this->FlightMap = flightMap;
+  if (this->FlightMap)
+  {
+    this->FlightMap->Register(this);
+  }
+
+  // The snapshot is of the old flight map. The filter may not have an input
+  // yet, so the new one is taken after the next render.
+  this->FlightMapSnapshot = 0;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------
+void vtkOffScreenWidget::UpdateFlightMapSnapshot()
+{
+  if (!this->FlightMap)
+  {
+    return;
+  }
+
+  // Route over an immutable copy of the flight map. The filter builds a new
+  // graph each time it executes, so a shallow copy is not changed by later
+  // updates. Jobs still planning keep the router (and copy) they were given.
+  this->FlightMap->Update();
+  vtkGraph* flightMap = this->FlightMap->GetOutput();
+  if (this->FlightMapSnapshot
+      && flightMap->GetMTime() <= this->FlightMapSnapshotTime)
+  {
+    return;
+  }
+  this->FlightMapSnapshot.TakeReference(
+      vtkGraph::SafeDownCast(flightMap->NewInstance()));
+  this->FlightMapSnapshot->ShallowCopy(flightMap);
+  this->FlightMapSnapshotTime.Modified();
+
+  vtkSmartPointer<vtkFlightMapRouter> router =
+      vtkSmartPointer<vtkFlightMapRouter>::New();
+  vtkOffScreenWidgetCopyRouterSettings(this->Router, router);
+  router->SetGraph(this->FlightMapSnapshot);
+  router->Update();
+  this->Router = router;
+}
+
+//----------------------------------------------------------------------
+void vtkOffScreenWidget::ProcessRenderEvents(vtkObject* vtkNotUsed(object),
+    unsigned long event, void* clientdata, void* vtkNotUsed(calldata))
+{
+  vtkOffScreenWidget* self = reinterpret_cast<vtkOffScreenWidget*>(clientdata);
+  // A flight renders every frame, so the map is left alone until it lands
+  if (event == vtkCommand::EndEvent
+      && self->WidgetState != vtkOffScreenWidget::Flying)
+  {
+    self->UpdateFlightMapSnapshot();
+  }
+}
+
 //----------------------------------------------------------------------
 void vtkOffScreenWidget::SetPicker(vtkAbstractPropPicker *picker)
 {
@@ -405,21 +1480,8 @@ void vtkOffScreenWidget::TimerStoppedAction(vtkAbstractWidget* w)
   if (timerId == self->FlightTimerId
       && self->WidgetState == vtkOffScreenWidget::Flying)
   {
-    // The flight timer timed out, take the next step
-    double* p = self->Itinerary->GetPoint(self->CurrentItineraryIndex);
-    self->History->AddElement(HistoryElement(p[0], p[1], p[2]));
-    self->MoveCameraTo(p[0], p[1], p[2]);
-    ++self->CurrentItineraryIndex;
-
-    if (self->CurrentItineraryIndex == self->LastItineraryIndex)
-    {
-      // That was the last leg of the flight
-      self->Interactor->DestroyTimer(self->FlightTimerId);
-      self->WidgetState = vtkOffScreenWidget::Stopped;
-      // Undraw the vapour trail
-      reinterpret_cast<vtkOffScreenRepresentation*>(self->WidgetRep)
-          ->UnHighlightFlightPath();
-    }
+    // The flight timer timed out, draw the frame that is due
+    self->DoFlightFrame();
     self->InvokeEvent(vtkCommand::TimerEvent, NULL);
     self->EventCallbackCommand->SetAbortFlag(1);
   }
@@ -430,12 +1492,9 @@ void vtkOffScreenWidget::SelectAction(vtkAbstractWidget* w)
 {
   vtkOffScreenWidget *self = reinterpret_cast<vtkOffScreenWidget*>(w);
 
-  // If widget is hovering we grab the selection event
-  if (self->WidgetState != vtkOffScreenWidget::Flying)
-  {
-    self->DoSelect();
-    self->InvokeEvent(vtkCommand::WidgetActivateEvent, NULL);
-  }
+  // A click during a flight re-routes it to the newly selected proxy
+  self->DoSelect();
+  self->InvokeEvent(vtkCommand::WidgetActivateEvent, NULL);
 }
 
 //-------------------------------------------------------------------------
@@ -490,24 +1549,16 @@ int vtkOffScreenWidget::DoHoverTest()
   vtkProp* pickedProp = this->Picker->GetViewProp();
   if (pickedProp == this->WidgetRep)
   {
-    double p1[3] =
-    { e[0], e[1], -0.1 };
-    double p2[3] =
-    { e[0], e[1], 0.1 };
-    vtkIdList* hits = vtkIdList::New();
-    vtkIdType cellId;
-
+    vtkIdType cellId = -1;
     if (offScreenPoly->GetNumberOfCells() > 0)
     {
-      this->CellLocator->SetDataSet(offScreenPoly);
-      this->CellLocator->BuildLocator();
-      this->CellLocator->FindCellsAlongLine(p1, p2, 0.0, hits);
+      this->UpdatePickIndex(offScreenPoly);
+      cellId = this->PickIndex->FindCell(e);
     }
 
-    if (hits->GetNumberOfIds() > 0)
+    if (cellId >= 0)
     {
       // Picking a proxy
-      cellId = hits->GetId(hits->GetNumberOfIds() - 1);
       vtkStringArray* labels = vtkStringArray::SafeDownCast(
           offScreenPoly->GetCellData()->GetAbstractArray("Hull name"));
       vtkPolyData* wedgie = vtkPolyData::New();
@@ -515,32 +1566,69 @@ int vtkOffScreenWidget::DoHoverTest()
           offScreenPoly->GetCellData()->GetAbstractArray("Hull id"));
       if (clusterIds)
       {
-        int clusterId = clusterIds->GetValue(cellId);
         vtkCellArray* polys = vtkCellArray::New();
-
-        // Find all cells with this wedge id and add to highlight polydata.
-        int n = offScreenPoly->GetNumberOfCells();
-        for (int i = 0; i < n; ++i)
+        vtkCellArray* strips = vtkCellArray::New();
+
+        // Add the cells with this wedge id to the highlight polydata.
+        const std::vector<vtkIdType>* cells =
+            this->PickIndex->GetHullCells(clusterIds->GetValue(cellId));
+        size_t n = cells ? cells->size() : 0;
+        vtkIdType npts;
+        vtkIdType* pts;
+        for (size_t i = 0; i < n; ++i)
         {
-          if (clusterIds->GetValue(i) == clusterId)
+          vtkIdType id = (*cells)[i];
+          offScreenPoly->GetCellPoints(id, npts, pts);
+          if (offScreenPoly->GetCellType(id) == VTK_TRIANGLE_STRIP)
           {
-            polys->InsertNextCell(offScreenPoly->GetCell(i));
+            strips->InsertNextCell(npts, pts);
+          }
+          else
+          {
+            polys->InsertNextCell(npts, pts);
           }
         }
 
         wedgie->SetPoints(offScreenPoly->GetPoints());
         wedgie->SetPolys(polys);
+        wedgie->SetStrips(strips);
         polys->Delete();
+        strips->Delete();
+      }
+
+      // Hovering over an aggregate proxy expands its bin; hovering over a
+      // proxy outside the expanded bin collapses it again
+      vtkIntArray* counts = vtkIntArray::SafeDownCast(
+          offScreenPoly->GetCellData()->GetAbstractArray("proxy count"));
+      vtkIntArray* bins = vtkIntArray::SafeDownCast(
+          offScreenPoly->GetCellData()->GetAbstractArray("aggregate bin"));
+      int count = counts ? counts->GetValue(cellId) : 1;
+      int bin = bins ? bins->GetValue(cellId) : -1;
+      if (count > 1)
+      {
+        widgetRep->SetExpandedProxyBin(bin);
+      }
+      else if (bin != widgetRep->GetExpandedProxyBin())
+      {
+        widgetRep->SetExpandedProxyBin(-1);
       }
 
       if (labels)
       {
+        vtksys_ios::ostringstream label;
+        label << labels->GetValue(cellId);
+        if (count > 1)
+        {
+          label << " (+" << count - 1 << " more)";
+        }
         reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->SetHoverText(
-            labels->GetValue(cellId));
+            label.str().c_str());
       }
 
+      // The aggregate glyph is replaced by the expanded bin on the next
+      // render, so it is not highlighted
       reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->SetHighlightPolyData(
-          wedgie);
+          count > 1 ? 0 : wedgie);
       this->WidgetRep->StartWidgetInteraction(e);
       this->Render();
       wedgie->Delete();
@@ -548,17 +1636,18 @@ int vtkOffScreenWidget::DoHoverTest()
     else
     {
       // Picking the bezel
+      widgetRep->SetExpandedProxyBin(-1);
       reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->SetHoverText(
           "");
       reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->SetHighlightPolyData(
           0);
       this->Render();
     }
-    hits->Delete();
   }
   else
   {
     // Not picking the widget at all
+    widgetRep->SetExpandedProxyBin(-1);
     reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->SetHoverText(
         "");
     reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->SetHighlightPolyData(
@@ -571,6 +1660,17 @@ int vtkOffScreenWidget::DoHoverTest()
   return 1;
 }
 
+//-------------------------------------------------------------------------
+void vtkOffScreenWidget::UpdatePickIndex(vtkPolyData* offScreenPoly)
+{
+  // The proxies are placed about the centre of the display, as in
+  // vtkOffScreenRepresentationImpl
+  int* size = this->CurrentRenderer->GetSize();
+  double centre[2] =
+  { static_cast<double>(size[0] / 2), static_cast<double>(size[1] / 2) };
+  this->PickIndex->Update(offScreenPoly, centre, this->PickTolerance);
+}
+
 //-------------------------------------------------------------------------
 int vtkOffScreenWidget::EndTimerAction()
 {
@@ -608,8 +1708,7 @@ int vtkOffScreenWidget::DoSelect()
   }
 
   this->Picker->AddPickList(widgetRep->GetOffScreenActor());
-  this->CellLocator->SetDataSet(offScreenPoly);
-  this->CellLocator->BuildLocator();
+  this->UpdatePickIndex(offScreenPoly);
 
   double e[2];
   e[0] = static_cast<double>(this->Interactor->GetEventPosition()[0]);
@@ -618,15 +1717,9 @@ int vtkOffScreenWidget::DoSelect()
   vtkAssemblyPath* path = this->Picker->GetPath();
   if (path != NULL)
   {
-    double p1[3] = { e[0], e[1], -0.1 };
-    double p2[3] = { e[0], e[1], 0.1 };
-    vtkSmartPointer<vtkIdList> hits = vtkSmartPointer<vtkIdList>::New();
-    vtkIdType cellId;
-    this->CellLocator->FindCellsAlongLine(p1, p2, 0.0, hits);
-
-    if (hits->GetNumberOfIds() > 0)
+    vtkIdType cellId = this->PickIndex->FindCell(e);
+    if (cellId >= 0)
     {
-      cellId = hits->GetId(hits->GetNumberOfIds() - 1);
       vtkDoubleArray* points = vtkDoubleArray::SafeDownCast(
           offScreenPoly->GetCellData()->GetAbstractArray("Hull point"));
       if (points)
@@ -659,6 +1752,7 @@ void vtkOffScreenWidget::CancelAction(vtkAbstractWidget *w)
       && self->WidgetState == vtkOffScreenWidget::Flying)
   {
     self->Interactor->DestroyTimer(self->FlightTimerId);
+    self->Planner->Cancel();
     self->WidgetState = vtkOffScreenWidget::Stopped;
     self->InvokeEvent(vtkCommand::TimerEvent, NULL);
     self->EventCallbackCommand->SetAbortFlag(1); //no one else gets this event
@@ -669,8 +1763,7 @@ void vtkOffScreenWidget::CancelAction(vtkAbstractWidget *w)
 void vtkOffScreenWidget::HistoryBackAction(vtkAbstractWidget* w)
 {
   vtkOffScreenWidget *self = reinterpret_cast<vtkOffScreenWidget*>(w);
-  HistoryElement e = self->History->GetHistoryBackwards();
-  self->MoveCameraTo(e.x, e.y, e.z);
+  self->ReplayHistory(true);
   self->InvokeEvent(vtkCommand::WidgetActivateEvent, NULL);
   self->EventCallbackCommand->SetAbortFlag(1); //no one else gets this event
 }
@@ -679,12 +1772,92 @@ void vtkOffScreenWidget::HistoryBackAction(vtkAbstractWidget* w)
 void vtkOffScreenWidget::HistoryForwardAction(vtkAbstractWidget* w)
 {
   vtkOffScreenWidget *self = reinterpret_cast<vtkOffScreenWidget*>(w);
-  HistoryElement e = self->History->GetHistoryForwards();
-  self->MoveCameraTo(e.x, e.y, e.z);
+  self->ReplayHistory(false);
   self->InvokeEvent(vtkCommand::WidgetActivateEvent, NULL);
   self->EventCallbackCommand->SetAbortFlag(1); //no one else gets this event
 }
 
+//----------------------------------------------------------------------------
+void vtkOffScreenWidget::SetHistoryBufferLength(int length)
+{
+  length = std::min(std::max(length, 1), 100000);
+  if (length != this->HistoryBufferLength)
+  {
+    this->HistoryBufferLength = length;
+    // A replay under way follows the table of an entry about to be freed
+    this->FlightPath->DetachTable();
+    this->History->SetMaxHistory(length);
+    this->Modified();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkOffScreenWidget::ReplayHistory(bool backwards)
+{
+  if (this->WidgetState == vtkOffScreenWidget::Flying)
+  {
+    return;
+  }
+  const FlightHistoryEntry* entry = backwards ?
+      this->History->GetHistoryBackwards() :
+      this->History->GetHistoryForwards();
+  if (!entry)
+  {
+    return;
+  }
+
+  // Fly along the camera path compiled when the stop was recorded
+  this->FlightPath->UseTable(entry->Table, backwards);
+  this->NumberOfFlightPathSamples =
+      static_cast<int>(this->FlightPath->GetNumberOfSamples());
+  int numKeyframes = FlightHistoryEntry::NumberOfKeyframes;
+  const FlightKeyframe& target =
+      entry->Path[backwards ? 0 : numKeyframes - 1];
+  for (int j = 0; j < 3; ++j)
+  {
+    this->ReplayViewUp[j] = target.ViewUp[j];
+  }
+
+  // Retrace a leg in a fifth of the time of a flight
+  this->CurrentFlightDuration = 0.2 * this->GetBiasedFlightDuration();
+  this->FlightStartTime = vtkTimerLog::GetUniversalTime();
+  this->FlightTakeOffTime = this->FlightStartTime;
+  this->FlightFrame = -1;
+  this->NumberOfFlightFrames = 0;
+  this->NumberOfDroppedFlightFrames = 0;
+  this->FlightFramesPerSecond = 0.0;
+  this->ReplayingHistory = true;
+
+  int frameInterval = static_cast<int>(1000.0 / this->FlightFrameRate);
+  this->FlightTimerId = this->Interactor->CreateRepeatingTimer(
+      frameInterval > 1 ? frameInterval : 1);
+  this->WidgetState = vtkOffScreenWidget::Flying;
+}
+
+//----------------------------------------------------------------------------
+void vtkOffScreenWidget::CompileHistoryEntry(FlightHistoryEntry* entry)
+{
+  if (!entry)
+  {
+    return;
+  }
+
+  // The path through the recorded keyframes between the two stops, which
+  // were spaced evenly along the original flight
+  this->HistoryPath->Initialize(0.0, 0.0, 0.0);
+  for (int i = 0; i < FlightHistoryEntry::NumberOfKeyframes; ++i)
+  {
+    const FlightKeyframe& keyframe = entry->Path[i];
+    double xy[3] =
+    { keyframe.FocalPoint[0], keyframe.FocalPoint[1], keyframe.FocalPoint[2] };
+    this->HistoryPath->AddPosition(i, xy);
+    this->HistoryPath->AddZoom(i, keyframe.ParallelScale);
+  }
+  this->HistoryPath->Compile(this->CurrentRenderer->GetSize()[1],
+      this->FlightPathTolerance);
+  this->HistoryPath->SwapTable(entry->Table);
+}
+
 //----------------------------------------------------------------------------
 void vtkOffScreenWidget::SetFlightType(int flightType)
 {
@@ -692,12 +1865,12 @@ void vtkOffScreenWidget::SetFlightType(int flightType)
   {
   case vtkOffScreenWidget::Express:
     this->FlightType = flightType;
-    this->FlightTimerDuration = 100;
+    this->FlightDuration = 4.0;
     this->FlightMap->SetExpressPreset();
     break;
   case vtkOffScreenWidget::Tourist:
     this->FlightType = flightType;
-    this->FlightTimerDuration = 125;
+    this->FlightDuration = 5.0;
     this->FlightMap->SetTouristPreset();
     break;
   default:
@@ -718,114 +1891,52 @@ void vtkOffScreenWidget::SetFlightTypeToTourist()
 }
 
 //----------------------------------------------------------------------------
-// Functor to compare distances in Dijkstra's SSSP, used in CalculateFlightPath
-struct vtkOffScreenWidgetCompareDistanceMap
-{
-  bool operator()(const std::pair<vtkIdType, double>& left,
-      const std::pair<vtkIdType, double>& right) const
-  {
-    return left.second < right.second;
-  }
-} CompareDistance;
-
-//----------------------------------------------------------------------------
-bool vtkOffScreenWidget::CalculateFlightPath(vtkIdType& startVertexId,
-    vtkIdType& endVertexId, double* startPoint, double* endPoint,
-    vtkPoints* itinerary)
+bool vtkOffScreenWidget::CalculateFlightPath(vtkFlightMapRouter* router,
+    vtkIdType& startVertexId, vtkIdType& endVertexId, double* startPoint,
+    double* endPoint, vtkPoints* itinerary)
 {
-  std::map<vtkIdType, double> distance;
-  std::map<vtkIdType, vtkIdType> predecessor;
-  vtkOutEdgeIterator* edges = vtkOutEdgeIterator::New();
-  vtkGraph* flightMap = this->FlightMap->GetOutput();
-  vtkIdType numVertices = flightMap->GetNumberOfVertices();
-  vtkDoubleArray* weight = vtkDoubleArray::SafeDownCast(
-      flightMap->GetEdgeData()->GetAbstractArray("weights"));
+  vtkGraph* flightMap = router->GetGraph();
 
   vtkTupleInterpolator* interpolator = vtkTupleInterpolator::New();
   interpolator->SetInterpolationTypeToLinear();
   interpolator->SetNumberOfComponents(3);
 
-  // Dijkstra's SSSP
-  for (vtkIdType v = 0; v < numVertices; ++v)
-  {
-    distance[v] = VTK_DOUBLE_MAX;
-    predecessor[v] = -1.0;
-  }
-
-  distance[startVertexId] = 0.0;
-  while (!distance.empty())
+  // Shortest path over the flight map
+  vtkIdList* forwardItinerary = vtkIdList::New();
+  vtkIdList* itineraryEdges = vtkIdList::New();
+  if (!router->FindPath(startVertexId, endVertexId, forwardItinerary,
+      itineraryEdges))
   {
-    std::pair<vtkIdType, double> minDist = *std::min_element(distance.begin(),
-        distance.end(), CompareDistance);
-    vtkIdType u = minDist.first;
-    if (distance[u] == VTK_DOUBLE_MAX)
-    {
-      // There is no path
-        interpolator->AddTuple(0.0, startPoint);
-        interpolator->AddTuple(1.0, endPoint);
-        double p[3];
-        for (int i = 0; i <= 4; i++)
-        {
-          interpolator->InterpolateTuple(0.25 * i, p);
-          itinerary->InsertNextPoint(p);
-        }
-        edges->Delete();
-        interpolator->Delete();
-        return false;
-      }
-    if (u == endVertexId)
-    {
-      break; // found the target
-    }
-
-    flightMap->GetOutEdges(u, edges);
-    while (edges->HasNext())
+    // There is no path
+    interpolator->AddTuple(0.0, startPoint);
+    interpolator->AddTuple(1.0, endPoint);
+    double p[3];
+    for (int i = 0; i <= 4; i++)
     {
-      vtkOutEdgeType edge = edges->Next();
-      vtkIdType v = edge.Target;
-      if (distance.count(v) == 0)
-        continue;
-
-      if (distance[u] + weight->GetValue(edge.Id) < distance[v])
-      {
-        distance[v] = distance[u] + weight->GetValue(edge.Id);
-        predecessor[v] = u;
-      }
+      interpolator->InterpolateTuple(0.25 * i, p);
+      itinerary->InsertNextPoint(p);
     }
-    distance.erase(u);
+    forwardItinerary->Delete();
+    itineraryEdges->Delete();
+    interpolator->Delete();
+    return false;
   }
-  edges->Delete();
+  vtkIdType numIds = forwardItinerary->GetNumberOfIds();
 
-  // Gather up the results
-  vtkIdType u = endVertexId;
-  vtkIdList* reverseItinerary = vtkIdList::New();
-  while (predecessor[u] >= 0)
-  {
-    reverseItinerary->InsertNextId(u);
-    u = predecessor[u];
-  }
-  reverseItinerary->InsertNextId(startVertexId);
-
-  // UnReverse the list
-  vtkIdType numIds = reverseItinerary->GetNumberOfIds();
-  vtkIdList* forwardItinerary = vtkIdList::New();
-  for (vtkIdType i = numIds - 1; i >= 0; --i)
-  {
-    forwardItinerary->InsertNextId(reverseItinerary->GetId(i));
-  }
-
-  // Get the point
-  itinerary->InsertNextPoint(flightMap->GetPoint(forwardItinerary->GetId(0)));
+  // The points may be shared with snapshots routed by other threads, so
+  // they are copied out rather than read through the array's tuple buffer
+  double vertexPoint[3];
+  flightMap->GetPoint(forwardItinerary->GetId(0), vertexPoint);
+  itinerary->InsertNextPoint(vertexPoint);
 
   for (vtkIdType i = 1; i < numIds; ++i)
   {
-    vtkIdType currentEdge = flightMap->GetEdgeId(forwardItinerary->GetId(i - 1),
-        forwardItinerary->GetId(i));
+    vtkIdType currentEdge = itineraryEdges->GetId(i - 1);
     vtkIdType npts;
     double* pts;
     flightMap->GetEdgePoints(currentEdge, npts, pts);
 
-    double* vertexPoint = flightMap->GetPoint(forwardItinerary->GetId(i - 1));
+    flightMap->GetPoint(forwardItinerary->GetId(i - 1), vertexPoint);
     itinerary->InsertNextPoint(vertexPoint);
 
     if (npts > 0)
@@ -859,15 +1970,46 @@ bool vtkOffScreenWidget::CalculateFlightPath(vtkIdType& startVertexId,
       }
     }
   }
-  itinerary->InsertNextPoint(
-      flightMap->GetPoint(forwardItinerary->GetId(numIds - 1)));
+  flightMap->GetPoint(forwardItinerary->GetId(numIds - 1), vertexPoint);
+  itinerary->InsertNextPoint(vertexPoint);
 
-  reverseItinerary->Delete();
   forwardItinerary->Delete();
+  itineraryEdges->Delete();
   interpolator->Delete();
   return true;
 }
 
+//----------------------------------------------------------------------------
+bool vtkOffScreenWidget::PlanFlight(vtkFlightMapRouter* router,
+    const double departure[3], const double arrival[3], vtkPoints* itinerary)
+{
+  // Runs on a planning thread, so it only uses the router and its snapshot
+  double departurePoint[3] =
+  { departure[0], departure[1], departure[2] };
+  double arrivalPoint[3] =
+  { arrival[0], arrival[1], arrival[2] };
+
+  // Find nearest vertex to start point, considering only the map points on the
+  // arrival side of the display centre so the flight at least starts off in
+  // roughly the right direction
+  double direction[2] =
+  { (arrivalPoint[0] - departurePoint[0]),
+      (arrivalPoint[1] - departurePoint[1]) };
+  vtkIdType closestToStart = router->FindClosestVertexInHalfPlane(
+      departurePoint, departurePoint, direction);
+  if (closestToStart < 0)
+  {
+    closestToStart = router->FindClosestVertex(departurePoint);
+  }
+
+  // Find nearest vertex to arrival point
+  vtkIdType closestToEnd = router->FindClosestVertex(arrivalPoint);
+
+  // Calculate flight itinerary
+  return this->CalculateFlightPath(router, closestToStart, closestToEnd,
+      departurePoint, arrivalPoint, itinerary);
+}
+
 //----------------------------------------------------------------------------
 void vtkOffScreenWidget::DoFlight(double* arrivalPoint)
 {
@@ -879,73 +2021,22 @@ void vtkOffScreenWidget::DoFlight(double* arrivalPoint)
   departurePoint[2] = 0.0;
   arrivalPoint[2] = 0.0;
 
-  // Find nearest vertex to start point - subset the map points so the flight at
-  // least starts off in roughly the right direction
-  double theta = vtkMath::Pi() / 2.0;
-  double direction[3] =
-  { (arrivalPoint[0] - departurePoint[0]),
-      (arrivalPoint[1] - departurePoint[1]), 0.0 };
-  double A[3] =
-  { departurePoint[0] + (direction[0] * cos(theta) - direction[1] * sin(theta)),
-      departurePoint[1]
-          + (direction[0] * sin(theta) + direction[1] * cos(theta)), 0.0 };
-  double B[3] =
-  { departurePoint[0] + (direction[0] * cos(theta) + direction[1] * sin(theta)),
-      departurePoint[1]
-          + (direction[0] * -sin(theta) + direction[1] * cos(theta)), 0.0 };
-
-  double side = ((B[0] - A[0]) * (arrivalPoint[1] - A[1]))
-      - ((B[1] - A[1]) * (arrivalPoint[0] - A[0]));
-
-  this->FlightMap->Update();
-  vtkGraph* flightMap = this->FlightMap->GetOutput();
-  vtkPoints* mapPoints = flightMap->GetPoints();
-  vtkIdType numMapPoints = mapPoints->GetNumberOfPoints();
-  vtkPoints* subsettedPoints = vtkPoints::New();
-  std::map<vtkIdType, vtkIdType> subsetToSetMap;
-  double C[3];
-  for (vtkIdType i = 0; i < numMapPoints; ++i)
-  {
-    mapPoints->GetPoint(i, C);
-    if ((((B[0] - A[0]) * (C[1] - A[1])) - ((B[1] - A[1]) * (C[0] - A[0])) <= 0)
-        == (side <= 0))
-    {
-      subsetToSetMap[subsettedPoints->InsertNextPoint(C)] = i;
-    }
+  // A new selection during a flight takes over from it
+  if (this->WidgetState == vtkOffScreenWidget::Flying)
+  {
+    this->Interactor->DestroyTimer(this->FlightTimerId);
+    reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->
+        UnHighlightFlightPath();
   }
 
-  this->PointLocator->BuildLocatorFromPoints(subsettedPoints);
-  double distance;
-  vtkIdType closestToStart =
-      subsetToSetMap[this->PointLocator->FindClosestPoint(departurePoint,
-          distance)];
-  subsettedPoints->Delete();
-
-  // Find nearest vertex to arrival point
-  this->PointLocator->BuildLocatorFromPoints(mapPoints);
-  vtkIdType closestToEnd = this->PointLocator->FindClosestPoint(arrivalPoint,
-      distance);
-
-  // Calculate flight itinerary
-  vtkPoints* itinerary = vtkPoints::New();
-  bool connected = this->CalculateFlightPath(closestToStart, closestToEnd,
-      departurePoint, arrivalPoint, itinerary);
-
-  // Taxi to itinerary start point
-  vtkPoints* taxiPath = vtkPoints::New();
-  taxiPath->InsertNextPoint(departurePoint);
-  taxiPath->InsertNextPoint(itinerary->GetPoint(0));
-  reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)
-      ->HighlightFlightPath(taxiPath, false);
-  this->MoveCameraTo(itinerary->GetPoint(0)[0], itinerary->GetPoint(0)[1],
-      this->CurrentRenderer->GetActiveCamera()->GetParallelScale());
-  reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->
-      UnHighlightFlightPath();
-  taxiPath->Delete();
-
-  // Draw con-trail
-  reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->HighlightFlightPath(
-      itinerary, connected);
+  // The router over the flight map snapshot is kept up to date after each
+  // render; only if there has been no render since the flight map was set
+  // is the snapshot taken here.
+  if (!this->FlightMapSnapshot)
+  {
+    this->UpdateFlightMapSnapshot();
+  }
+  this->Planner->Submit(this, this->Router, departurePoint, arrivalPoint);
 
   // Amount of zoom depends on distance between start and end as proportion of world
   double flightDistance = sqrt(
@@ -963,114 +2054,265 @@ void vtkOffScreenWidget::DoFlight(double* arrivalPoint)
   {
     maxZoom = startZoom;
   }
+  this->FlightMaxZoom = maxZoom;
+  this->FlightLandingZoom = startZoom;
+
+  // Head straight for the target until the route has been planned
+  vtkPoints* directPath = vtkPoints::New();
+  directPath->InsertNextPoint(departurePoint);
+  directPath->InsertNextPoint(arrivalPoint);
+  this->StartFlightPath(directPath, startZoom,
+      this->GetBiasedFlightDuration());
+  directPath->Delete();
+
+  // Lift off!
+  int frameInterval = static_cast<int>(1000.0 / this->FlightFrameRate);
+  this->FlightTimerId = this->Interactor->CreateRepeatingTimer(
+      frameInterval > 1 ? frameInterval : 1);
+  this->WidgetState = vtkOffScreenWidget::Flying;
+  this->NumberOfFlightFrames = 0;
+  this->NumberOfDroppedFlightFrames = 0;
+  this->FlightFramesPerSecond = 0.0;
+  this->ItineraryReductionRatio = 1.0;
+  this->FlightTakeOffTime = this->FlightStartTime;
+  this->ReplayingHistory = false;
+  FlightKeyframe departure;
+  vtkCamera* camera = this->CurrentRenderer->GetActiveCamera();
+  departure.Set(camera->GetFocalPoint(), startZoom, camera->GetViewUp());
+  this->CompileHistoryEntry(this->History->BeginTrail(departure));
+}
+
+//----------------------------------------------------------------------------
+void vtkOffScreenWidget::SpliceFlightPath(vtkPoints* itinerary,
+    bool connected)
+{
+  vtkCamera* camera = this->CurrentRenderer->GetActiveCamera();
+  double cameraPoint[3];
+  camera->GetFocalPoint(cameraPoint);
+  cameraPoint[2] = 0.0;
+
+  // Join the route after the itinerary point nearest the camera, which has
+  // been heading for the target meanwhile
+  vtkIdType numItineraryPoints = itinerary->GetNumberOfPoints();
+  vtkIdType nearest = 0;
+  double nearestDistance = VTK_DOUBLE_MAX;
+  for (vtkIdType i = 0; i < numItineraryPoints; ++i)
+  {
+    double* p = itinerary->GetPoint(i);
+    double distance = (p[0] - cameraPoint[0]) * (p[0] - cameraPoint[0])
+        + (p[1] - cameraPoint[1]) * (p[1] - cameraPoint[1]);
+    if (distance < nearestDistance)
+    {
+      nearest = i;
+      nearestDistance = distance;
+    }
+  }
+  vtkPoints* splicedPath = vtkPoints::New();
+  splicedPath->InsertNextPoint(cameraPoint);
+  for (vtkIdType i = std::min(nearest + 1, numItineraryPoints - 1);
+      i < numItineraryPoints; ++i)
+  {
+    splicedPath->InsertNextPoint(itinerary->GetPoint(i));
+  }
+
+  // Drop the turns of the route too small to see at the current zoom
+  // before fitting the camera path to it. The con-trail shows all of it.
+  if (this->ItineraryTolerance > 0.0)
+  {
+    double worldPerPixel = 2.0 * camera->GetParallelScale()
+        / std::max(this->CurrentRenderer->GetSize()[1], 1);
+    vtkPoints* simplifiedPath = vtkPoints::New();
+    vtkOffScreenWidgetSimplifyPath(splicedPath,
+        this->ItineraryTolerance * worldPerPixel, simplifiedPath);
+    this->ItineraryReductionRatio =
+        static_cast<double>(simplifiedPath->GetNumberOfPoints())
+            / splicedPath->GetNumberOfPoints();
+    splicedPath->Delete();
+    splicedPath = simplifiedPath;
+  }
+  else
+  {
+    this->ItineraryReductionRatio = 1.0;
+  }
+
+  // Draw con-trail
+  reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)->HighlightFlightPath(
+      itinerary, connected);
+
+  // Keep to the time of arrival, but take at least half a flight over the
+  // rest of the route
+  double remaining = this->CurrentFlightDuration
+      - (vtkTimerLog::GetUniversalTime() - this->FlightStartTime);
+  this->StartFlightPath(splicedPath, camera->GetParallelScale(),
+      std::max(remaining, 0.5 * this->CurrentFlightDuration));
+  splicedPath->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkOffScreenWidget::StartFlightPath(vtkPoints* itinerary,
+    double startZoom, double duration)
+{
+  double maxZoom = std::max(this->FlightMaxZoom, startZoom);
 
-  // Smooth the zoom path
+  // Smooth the x,y-path through the itinerary, and the zoom path, returning
+  // to the zoom at take-off on arrival
   vtkIdType numItineraryPoints = itinerary->GetNumberOfPoints();
-  vtkKochanekSpline* zoomSpline = vtkKochanekSpline::New();
-  zoomSpline->SetDefaultBias(0.0);
-  zoomSpline->SetDefaultTension(0.0);
-  zoomSpline->SetDefaultContinuity(0.0);
-  zoomSpline->SetClosed(false);
-  vtkTupleInterpolator* zoomInterpolator = vtkTupleInterpolator::New();
-  zoomInterpolator->SetNumberOfComponents(1);
-  zoomInterpolator->SetInterpolationTypeToSpline();
-  zoomInterpolator->SetInterpolatingSpline(zoomSpline);
-  zoomSpline->Delete();
-  zoomInterpolator->AddTuple(0.0 * numItineraryPoints, &startZoom);
-  zoomInterpolator->AddTuple(0.3333 * numItineraryPoints, &maxZoom);
-  zoomInterpolator->AddTuple(0.6667 * numItineraryPoints, &maxZoom);
-  zoomInterpolator->AddTuple(1.0 * numItineraryPoints, &startZoom);
-
-  // Smooth the x,y-path
-  vtkKochanekSpline* xySpline = vtkKochanekSpline::New();
-  xySpline->SetDefaultBias(0.5);
-  xySpline->SetDefaultTension(0.25);
-  xySpline->SetDefaultContinuity(-1.0);
-  xySpline->SetClosed(false);
-  vtkTupleInterpolator* xyInterpolator = vtkTupleInterpolator::New();
-  xyInterpolator->SetNumberOfComponents(3);
-  xyInterpolator->SetInterpolationTypeToSpline();
-  xyInterpolator->SetInterpolatingSpline(xySpline);
-  xySpline->Delete();
+  double pathLength = static_cast<double>(numItineraryPoints - 1);
+  this->FlightPath->Initialize(0.5, 0.25, -1.0);
   for (vtkIdType i = 0; i < numItineraryPoints; ++i)
   {
-    xyInterpolator->AddTuple(1.0 * i, itinerary->GetPoint(i));
+    this->FlightPath->AddPosition(i, itinerary->GetPoint(i));
   }
+  this->FlightPath->AddZoom(0.0 * pathLength, startZoom);
+  this->FlightPath->AddZoom(0.3333 * pathLength, maxZoom);
+  this->FlightPath->AddZoom(0.6667 * pathLength, maxZoom);
+  this->FlightPath->AddZoom(1.0 * pathLength, this->FlightLandingZoom);
+  this->FlightPath->Compile(this->CurrentRenderer->GetSize()[1],
+      this->FlightPathTolerance);
+  this->NumberOfFlightPathSamples =
+      static_cast<int>(this->FlightPath->GetNumberOfSamples());
+
+  this->CurrentFlightDuration = duration;
+  this->FlightStartTime = vtkTimerLog::GetUniversalTime();
+  this->FlightFrame = -1;
+}
+
+//----------------------------------------------------------------------------
+#ifndef VTK_LEGACY_REMOVE
+void vtkOffScreenWidget::SetFlightTimerDuration(int milliseconds)
+{
+  VTK_LEGACY_REPLACED_BODY(vtkOffScreenWidget::SetFlightTimerDuration,
+      "vtkcsmWidgets", vtkOffScreenWidget::SetFlightDuration);
+  this->SetFlightDuration(milliseconds / 25.0);
+}
+#endif
+
+//----------------------------------------------------------------------------
+#ifndef VTK_LEGACY_REMOVE
+int vtkOffScreenWidget::GetFlightTimerDuration()
+{
+  VTK_LEGACY_REPLACED_BODY(vtkOffScreenWidget::GetFlightTimerDuration,
+      "vtkcsmWidgets", vtkOffScreenWidget::GetFlightDuration);
+  return vtkMath::Round(this->FlightDuration * 25.0);
+}
+#endif
 
-  double resolution = 4.0;
-  vtkIdType numSmoothedItineraryPoints = numItineraryPoints * resolution;
-  double interpolatedCameraXY[2];
-  double interpolatedCameraZoom;
-  double interpolationT;
-  this->Itinerary->Initialize();
+//----------------------------------------------------------------------------
+double vtkOffScreenWidget::GetBiasedFlightDuration()
+{
+  return this->FlightDuration * (100 + this->FlightSpeedBias) / 100.0;
+}
 
-  for (vtkIdType i = 0; i < numSmoothedItineraryPoints; ++i)
+//----------------------------------------------------------------------------
+void vtkOffScreenWidget::DoFlightFrame()
+{
+  // Switch to the planned route as soon as it is ready
+  vtkSmartPointer<vtkPoints> route;
+  bool connected;
+  if (this->Planner->Poll(route, connected))
   {
-    interpolationT = i / resolution;
-    zoomInterpolator->InterpolateTuple(interpolationT, &interpolatedCameraZoom);
-    xyInterpolator->InterpolateTuple(interpolationT, interpolatedCameraXY);
-    this->Itinerary->InsertNextPoint(interpolatedCameraXY[0],
-        interpolatedCameraXY[1], interpolatedCameraZoom);
+    this->SpliceFlightPath(route, connected);
   }
 
-  // Lift off!
-  this->FlightTimerId = this->Interactor->CreateRepeatingTimer(
-      this->FlightTimerDuration + this->FlightSpeedBias);
-  this->WidgetState = vtkOffScreenWidget::Flying;
-  this->CurrentItineraryIndex = 0;
-  this->LastItineraryIndex = numSmoothedItineraryPoints;
-  this->History->AddElement(
-      HistoryElement(departurePoint[0], departurePoint[1], startZoom));
-
-  itinerary->Delete();
-  zoomInterpolator->Delete();
-  xyInterpolator->Delete();
+  // Find the frame due at the time elapsed along the path. Frames that fell
+  // due while the last one was rendering are dropped, not drawn late.
+  double elapsed = vtkTimerLog::GetUniversalTime() - this->FlightStartTime;
+  double frameInterval = 1.0 / this->FlightFrameRate;
+  bool arrived = elapsed >= this->CurrentFlightDuration;
+  vtkIdType lastFrame = static_cast<vtkIdType>(
+      ceil(this->CurrentFlightDuration / frameInterval));
+  vtkIdType frame = arrived ?
+      lastFrame : static_cast<vtkIdType>(elapsed / frameInterval);
+  if (frame <= this->FlightFrame)
+  {
+    // Woken early; the current frame has already been drawn
+    return;
+  }
+  if (frame > this->FlightFrame + 1)
+  {
+    this->NumberOfDroppedFlightFrames +=
+        static_cast<int>(frame - this->FlightFrame - 1);
+  }
+  this->FlightFrame = frame;
+
+  // Look up the camera placement at the elapsed time
+  double u = arrived || this->CurrentFlightDuration <= 0.0 ?
+      1.0 : elapsed / this->CurrentFlightDuration;
+  double xy[2];
+  double zoom;
+  this->FlightPath->Evaluate(u, xy, zoom);
+  this->MoveCameraTo(xy[0], xy[1], zoom);
+  vtkCamera* camera = this->CurrentRenderer->GetActiveCamera();
+  if (!this->ReplayingHistory)
+  {
+    FlightKeyframe keyframe;
+    keyframe.Set(camera->GetFocalPoint(), zoom, camera->GetViewUp());
+    this->History->AddToTrail(keyframe);
+  }
+
+  ++this->NumberOfFlightFrames;
+  double flown = vtkTimerLog::GetUniversalTime() - this->FlightTakeOffTime;
+  this->FlightFramesPerSecond =
+      flown > 0.0 ? this->NumberOfFlightFrames / flown : 0.0;
+
+  if (arrived)
+  {
+    // That was the last leg of the flight
+    this->Interactor->DestroyTimer(this->FlightTimerId);
+    if (this->Planner->Cancel())
+    {
+      // The route came too late to fly, so the flight went straight there
+      ++this->NumberOfUnplannedFlights;
+      vtkDebugMacro(<< "Landed before the flight was planned");
+    }
+    if (this->ReplayingHistory)
+    {
+      camera->SetViewUp(this->ReplayViewUp);
+      this->Interactor->Render();
+    }
+    else
+    {
+      this->CompileHistoryEntry(this->History->EndTrail());
+    }
+    this->WidgetState = vtkOffScreenWidget::Stopped;
+    // Undraw the vapour trail
+    reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep)
+        ->UnHighlightFlightPath();
+  }
 }
 
 //----------------------------------------------------------------------------
 void vtkOffScreenWidget::MoveCameraTo(const double& x, const double& y,
     const double& parallelScale)
+{
+  this->PlaceCamera(x, y, parallelScale);
+  this->Interactor->Render();
+}
+
+//----------------------------------------------------------------------------
+void vtkOffScreenWidget::PlaceCamera(const double& x, const double& y,
+    const double& parallelScale)
 {
   vtkRenderer* ren = this->GetCurrentRenderer();
   vtkCamera* camera = ren->GetActiveCamera();
 
-  double flyFrom[3];
-  double positionFrom[3];
-  double flyTo[3];
-  camera->GetFocalPoint(flyFrom);
-  camera->GetPosition(positionFrom);
-  flyTo[0] = x;
-  flyTo[1] = y;
-  flyTo[2] = flyFrom[2];
-
-  double d[3];
-  d[0] = flyTo[0] - flyFrom[0];
-  d[1] = flyTo[1] - flyFrom[1];
-  d[2] = 0.0;
-  double distance = vtkMath::Normalize(d);
-  //  int resolution = this->Interactor->GetNumberOfFlyFrames();
-  int resolution = 1;
-  double delta = distance / resolution;
-
-  double startScale = camera->GetParallelScale();
-  double zoomDelta = (parallelScale - startScale) / resolution;
-  double scale = startScale;
-
-  double focalPt[3], position[3];
-  for (int i = 1; i <= resolution; i++)
-  {
-    for (int j = 0; j < 3; j++)
-    {
-      focalPt[j] = flyFrom[j] + d[j] * i * delta;
-      position[j] = positionFrom[j] + d[j] * i * delta;
-    }
-    scale = startScale + i * zoomDelta;
-    ren->GetActiveCamera()->SetFocalPoint(focalPt);
-    ren->GetActiveCamera()->SetPosition(position);
-    ren->GetActiveCamera()->SetParallelScale(scale);
-    ren->ResetCameraClippingRange();
-    this->Interactor->Render();
+  // Translate the focal point and position together, keeping the view
+  // direction
+  double focalPt[3];
+  double position[3];
+  camera->GetFocalPoint(focalPt);
+  camera->GetPosition(position);
+  double d[2] =
+  { x - focalPt[0], y - focalPt[1] };
+  for (int j = 0; j < 2; ++j)
+  {
+    focalPt[j] += d[j];
+    position[j] += d[j];
   }
+  camera->SetFocalPoint(focalPt);
+  camera->SetPosition(position);
+  camera->SetParallelScale(parallelScale);
+  ren->ResetCameraClippingRange();
 }
 
 //-------------------------------------------------------------------------
@@ -1146,6 +2388,22 @@ bool vtkOffScreenWidget::GetShowError()
   return repr->GetShowError();
 }
 
+//-------------------------------------------------------------------------
+void vtkOffScreenWidget::SetAggregateProxies(bool b)
+{
+  vtkOffScreenRepresentation* repr =
+      reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep);
+  repr->SetAggregateProxies(b);
+}
+
+//-------------------------------------------------------------------------
+bool vtkOffScreenWidget::GetAggregateProxies()
+{
+  vtkOffScreenRepresentation* repr =
+      reinterpret_cast<vtkOffScreenRepresentation*>(this->WidgetRep);
+  return repr->GetAggregateProxies();
+}
+
 //-------------------------------------------------------------------------
 void vtkOffScreenWidget::SetWorldSize(double s)
 {
@@ -1162,13 +2420,27 @@ void vtkOffScreenWidget::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Stop Timer Duration: " << this->StopTimerDuration << "\n";
   os << indent << "Hover Timer Duration: " << this->HoverTimerDuration << "\n";
   os << indent << "Dimmer Timer Duration: " << this->DimmerTimerDuration << "\n";
-  os << indent << "Flight Timer Duration: " << this->FlightTimerDuration << "\n";
+  os << indent << "Flight Duration: " << this->FlightDuration << "\n";
+  os << indent << "Flight Path Tolerance: " << this->FlightPathTolerance
+      << "\n";
+  os << indent << "Number Of Flight Path Samples: "
+      << this->NumberOfFlightPathSamples << "\n";
+  os << indent << "Itinerary Tolerance: " << this->ItineraryTolerance << "\n";
+  os << indent << "Itinerary Reduction Ratio: "
+      << this->ItineraryReductionRatio << "\n";
+  os << indent << "Flight Frame Rate: " << this->FlightFrameRate << "\n";
+  os << indent << "Flight Frames Per Second: " << this->FlightFramesPerSecond
+      << "\n";
+  os << indent << "Number Of Dropped Flight Frames: "
+      << this->NumberOfDroppedFlightFrames << "\n";
+  os << indent << "Number Of Unplanned Flights: "
+      << this->NumberOfUnplannedFlights << "\n";
   os << indent << "Auto Dim: " << (this->AutoDim ? "On" : "Off") << "\n";
   os << indent << "Flight Speed Bias: " << this->FlightSpeedBias << "\n";
   os << indent << "History Buffer Length: " << this->HistoryBufferLength << "\n";
+  os << indent << "Replaying History: " << this->ReplayingHistory << "\n";
   os << indent << "Flight Map: " << this->FlightMap << "\n";
-  os << indent << "Cell Locator: " << "\n";
-  this->CellLocator->PrintSelf(os, indent.GetNextIndent());
-  os << indent << "Point Locator: " << "\n";
-    this->PointLocator->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "Pick Tolerance: " << this->PickTolerance << "\n";
+  os << indent << "Router: " << "\n";
+  this->Router->PrintSelf(os, indent.GetNextIndent());
 }
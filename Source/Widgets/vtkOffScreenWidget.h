@@ -30,6 +30,11 @@
 // animation the zoom is level is such that the entire path can be viewed. To
 // facilitate this the followed path is highlighted.
 //
+// Routes are planned on a background thread against a snapshot of the flight
+// map, so the camera sets off straight towards the target at once and turns
+// onto the route when it has been planned. Selecting another proxy during a
+// flight re-routes it, discarding any route still being planned.
+//
 // The design of this class is based on vtkHoverWidget.
 //
 // .SECTION Event Bindings
@@ -54,17 +59,29 @@
 #include "vtkAbstractWidget.h"
 #include "vtkSmartPointer.h" // for class ivars
 
-// Private class used to store flight path nodes during animation for
+// Private class used to store camera keyframes of past flights for
 // later playback.
 class FlightHistory;
+struct FlightHistoryEntry;
+
+// Private class indexing the proxies by angle for hover and select picking.
+class vtkOffScreenWidgetPickIndex;
+
+// Private class planning flight routes on background threads.
+class vtkOffScreenWidgetFlightPlanner;
+
+// Private class sampling the camera path of a flight.
+class vtkOffScreenWidgetCameraPath;
 
 class vtkAbstractPropPicker;
+class vtkCallbackCommand;
 class vtkCellCenters;
-class vtkCellLocator;
 class vtkFlightMapFilter;
-class vtkKdTree;
+class vtkFlightMapRouter;
+class vtkGraph;
 class vtkOffScreenRepresentation;
 class vtkPoints;
+class vtkPolyData;
 
 
 class VTK_CSM_WIDGETS_EXPORT vtkOffScreenWidget: public vtkAbstractWidget
@@ -89,13 +106,75 @@ public:
   vtkGetMacro(DimmerTimerDuration, int)
 
   // Description:
-  // Specify the interval between each step in an animated 'flight'.
-  vtkSetClampMacro(FlightTimerDuration, int, 1, 100000)
-  vtkGetMacro(FlightTimerDuration, int)
+  // Specify the time (in seconds) a flight takes, before the flight speed
+  // bias is applied. It does not depend on the length of the route or on
+  // how long each frame takes to render. Default 4.
+  vtkSetClampMacro(FlightDuration, double, 0.1, 60.0)
+  vtkGetMacro(FlightDuration, double)
+
+  // Description:
+  // @deprecated Replaced by SetFlightDuration() and SetFlightFrameRate().
+  // The timer duration was the time (in milliseconds) of each step of a
+  // flight; it is mapped onto a flight duration of 40 steps, so the 100
+  // milliseconds of the express preset give its 4 second flight.
+  VTK_LEGACY(void SetFlightTimerDuration(int milliseconds));
+  VTK_LEGACY(int GetFlightTimerDuration());
+
+  // Description:
+  // Specify how closely (in display pixels) the camera follows the
+  // smoothed flight path. The path is sampled more finely where it bends
+  // or zooms quickly and more coarsely elsewhere. Default 0.5.
+  vtkSetClampMacro(FlightPathTolerance, double, 0.01, 100.0)
+  vtkGetMacro(FlightPathTolerance, double)
+
+  // Description:
+  // The number of samples in the camera path of the last (or current)
+  // flight.
+  vtkGetMacro(NumberOfFlightPathSamples, int)
+
+  // Description:
+  // Specify the size (in display pixels at the zoom when the route is
+  // joined) of the turns in a route that the camera path leaves out. The
+  // route is simplified with the Douglas-Peucker algorithm before the camera
+  // path is fitted to it, while the highlighted route keeps every vertex.
+  // Zero disables simplification. Default 1.
+  vtkSetClampMacro(ItineraryTolerance, double, 0.0, 100.0)
+  vtkGetMacro(ItineraryTolerance, double)
+
+  // Description:
+  // The number of route points the camera path of the last (or current)
+  // flight was fitted to, divided by the number of points of the planned
+  // route ahead of the camera. One when nothing was left out.
+  vtkGetMacro(ItineraryReductionRatio, double)
+
+  // Description:
+  // Specify the number of frames per second to render during a flight.
+  // Frames are placed at the time elapsed since take-off, so when rendering
+  // cannot keep up the camera skips ahead rather than slowing down.
+  // Default 30.
+  vtkSetClampMacro(FlightFrameRate, double, 1.0, 120.0)
+  vtkGetMacro(FlightFrameRate, double)
+
+  // Description:
+  // The number of frames per second achieved by the last (or current)
+  // flight, and the number of its frames that were dropped because rendering
+  // fell behind.
+  vtkGetMacro(FlightFramesPerSecond, double)
+  vtkGetMacro(NumberOfDroppedFlightFrames, int)
+
+  // Description:
+  // The number of flights, since the widget was created, that landed before
+  // their route was planned. These fly straight to their target, and the
+  // route, when it arrives, is discarded.
+  vtkGetMacro(NumberOfUnplannedFlights, int)
 
   // Description:
-  // Specify the maximum number of flight legs to remember.
-  vtkSetClampMacro(HistoryBufferLength, int, 1, 5000)
+  // Specify the maximum number of stops (departures and arrivals of
+  // flights) to remember. The history is a ring buffer allocated when this
+  // is set, which also clears it. Each stop takes a few kilobytes, most of
+  // it the camera path compiled when the stop is recorded so that replaying
+  // it is immediate, so thousands can be kept for long sessions. Default 250.
+  void SetHistoryBufferLength(int length);
   vtkGetMacro(HistoryBufferLength, int)
 
   // Description:
@@ -139,7 +218,10 @@ public:
   void SetLandmarkCentres(vtkCellCenters* cellCenters);
 
   // Description:
-  // Set the flight map (determines routes between landmarks).
+  // Set the flight map (determines routes between landmarks). Flights are
+  // routed over a snapshot of its output, refreshed after each render of the
+  // widget's renderer while the widget is not flying, so a change to the
+  // flight map is picked up by the first flight after the next render.
   void SetFlightMap(vtkFlightMapFilter* flightMap);
   vtkGetObjectMacro(FlightMap, vtkFlightMapFilter)
 
@@ -150,9 +232,9 @@ public:
   void SetFlightTypeToTourist();
 
   // Description:
-  // The flight speed bias is added to the timer duration between points along
-  // a camera flight, with the effect of slowing it down for positive values and
-  // vice versa. Clamped to values -75 <= bias <= 75.
+  // The flight speed bias lengthens the flight duration by this percentage,
+  // with the effect of slowing it down for positive values and vice versa.
+  // Clamped to values -75 <= bias <= 75.
   vtkSetClampMacro(FlightSpeedBias, int, -75, 75)
   vtkGetMacro(FlightSpeedBias, int)
 
@@ -184,9 +266,18 @@ public:
   void SetShowError(bool b);
   bool GetShowError();
 
+  // Description:
+  // Collapse off-screen proxies that share an angular and distance bin into
+  // one aggregate proxy, drawn deeper the more landmarks it stands for.
+  // Hovering over an aggregate expands its bin into individual proxies.
+  void SetAggregateProxies(bool b);
+  bool GetAggregateProxies();
+
   // Description:
   // Set the "world size", the diagonal of the bounding box of the underlying
   // scene in world coordinates. Used to calculate the length of proxy pointers.
+  // If 0 (the default), the diagonal of the bounds of the landmark centres is
+  // used.
   void SetWorldSize(double s);
 
 protected:
@@ -225,10 +316,59 @@ protected:
   int DoSelect();
 
   void DoFlight(double* arrivalPoint);
-  bool CalculateFlightPath(vtkIdType& startVertexId, vtkIdType& endVertexId,
-      double* startPoint, double* endPoint, vtkPoints* itinerary);
+  void DoFlightFrame();
+
+  // Description:
+  // Bring the flight map up to date and, if its output has changed since the
+  // last snapshot, replace the router with one over a new snapshot. The
+  // router's search structures are built here, on the GUI thread, so the
+  // planning threads only read them.
+  void UpdateFlightMapSnapshot();
+
+  // Refreshes the flight map snapshot at the end of each render.
+  static void ProcessRenderEvents(vtkObject* object, unsigned long event,
+      void* clientdata, void* calldata);
+  vtkCallbackCommand* RenderCallbackCommand;
+
+  // Description:
+  // Route a flight over the flight map snapshot held by router. Called on a
+  // planning thread, so it must not touch anything else.
+  bool PlanFlight(vtkFlightMapRouter* router, const double departure[3],
+      const double arrival[3], vtkPoints* itinerary);
+  friend class vtkOffScreenWidgetFlightPlanner;
+
+  // Description:
+  // Fit the camera path of the flight to an itinerary, starting at
+  // startZoom, and restart its clock.
+  void StartFlightPath(vtkPoints* itinerary, double startZoom,
+      double duration);
+
+  // Description:
+  // The flight duration with the flight speed bias applied.
+  double GetBiasedFlightDuration();
+
+  // Description:
+  // Divert the flight from where the camera is onto a planned route.
+  void SpliceFlightPath(vtkPoints* itinerary, bool connected);
+
+  // Description:
+  // Fly to the previous or next stop in the history along the keyframes
+  // recorded for it.
+  void ReplayHistory(bool backwards);
+
+  // Description:
+  // Compile the camera path of a newly recorded history entry, if any.
+  void CompileHistoryEntry(FlightHistoryEntry* entry);
+  bool CalculateFlightPath(vtkFlightMapRouter* router,
+      vtkIdType& startVertexId, vtkIdType& endVertexId, double* startPoint,
+      double* endPoint, vtkPoints* itinerary);
   void MoveCameraTo(const double& x, const double& y,
       const double& parallelScale);
+  void PlaceCamera(const double& x, const double& y,
+      const double& parallelScale);
+
+  // Refresh the pick index over the proxies in the off-screen polydata.
+  void UpdatePickIndex(vtkPolyData* offScreenPoly);
 
   // Timer handles and durations.
   int StopTimerId;
@@ -238,7 +378,6 @@ protected:
   int DimmerTimerId;
   int DimmerTimerDuration;
   int FlightTimerId;
-  int FlightTimerDuration;
 
   // Control the dimming animation.
   bool AutoDim;
@@ -250,18 +389,44 @@ protected:
   // Speed up/slow down the camera animation speed.
   int FlightSpeedBias;
 
-  // Flight map, route, and history.
+  // Flight map, route, and history. The router is only used by the flight
+  // planner, over a snapshot of the flight map; it is replaced, not
+  // modified, when the flight map changes.
   vtkFlightMapFilter* FlightMap;
+  vtkSmartPointer<vtkFlightMapRouter> Router;
+  vtkSmartPointer<vtkGraph> FlightMapSnapshot;
+  vtkTimeStamp FlightMapSnapshotTime;
+  vtkOffScreenWidgetFlightPlanner* Planner;
   FlightHistory* History;
-  vtkSmartPointer<vtkPoints> Itinerary;
-  vtkIdType CurrentItineraryIndex;
-  vtkIdType LastItineraryIndex;
   int HistoryBufferLength;
+  bool ReplayingHistory;
+  double ReplayViewUp[3];
+
+  // The camera path of the current flight and its timing, and the path
+  // used to compile history entries.
+  vtkOffScreenWidgetCameraPath* FlightPath;
+  vtkOffScreenWidgetCameraPath* HistoryPath;
+  double FlightPathTolerance;
+  int NumberOfFlightPathSamples;
+  double ItineraryTolerance;
+  double ItineraryReductionRatio;
+  double FlightMaxZoom;
+  double FlightLandingZoom;
+  double FlightDuration;
+  double CurrentFlightDuration;
+  double FlightStartTime;
+  double FlightTakeOffTime;
+  double FlightFrameRate;
+  vtkIdType FlightFrame;
+  int NumberOfFlightFrames;
+  int NumberOfDroppedFlightFrames;
+  double FlightFramesPerSecond;
+  int NumberOfUnplannedFlights;
 
   // Picking
   vtkAbstractPropPicker* Picker;
-  vtkSmartPointer<vtkCellLocator> CellLocator;
-  vtkSmartPointer<vtkKdTree> PointLocator;
+  vtkOffScreenWidgetPickIndex* PickIndex;
+  double PickTolerance;
 
 private:
   vtkOffScreenWidget(const vtkOffScreenWidget&); //Not implemented